@@ -0,0 +1,385 @@
+#include <stdlib.h>
+
+#include "bdd.h"
+
+struct BddNode {
+	int level; // of the variable; n_levels for the constants, -1 if free
+	Bdd low;   // where the variable is F
+	Bdd high;  // where the variable is T
+	Bdd next;  // in the bucket of the unique table, or in the free list
+	int refs;  // by bdd_ref
+	bool marked;
+};
+
+struct ComputedEntry {
+	Bdd f, g, h; // f is -1 if the entry is empty
+	Bdd result;
+};
+
+/* The computed table has as many entries as the unique table has
+ * buckets, at first this many.
+ */
+#define MIN_BUCKETS 256
+
+struct BddManager {
+	int n_levels;
+	struct BddNode *nodes;
+	long n_nodes; // used so far, including free ones
+	long cap_nodes;
+	long max_nodes;
+	long live;    // not free
+	long gc_at;   // bdd_of_expr collects garbage when live reaches this
+	Bdd free_list;
+	Bdd *buckets; // of the unique table, -1 if empty
+	long n_buckets;
+	struct ComputedEntry *computed;
+	bool overflow;
+};
+
+static unsigned long long hash3(long a, long b, long c) {
+	unsigned long long h = a * 0x9e3779b97f4a7c15ULL;
+	h = (h ^ b) * 0xbf58476d1ce4e5b9ULL;
+	h = (h ^ c) * 0x94d049bb133111ebULL;
+	return h ^ (h >> 31);
+}
+
+static void clear_computed(struct BddManager *manager) {
+	for (long i = 0; i < manager->n_buckets; i++)
+		manager->computed[i].f = -1;
+}
+
+static long bucket_of(struct BddManager *manager, int level, Bdd low, Bdd high) {
+	return hash3(level, low, high) & (manager->n_buckets - 1);
+}
+
+/* Put all nodes that are not free into buckets, of which there are
+ * n_buckets, and empty the computed table.
+ */
+static void rehash(struct BddManager *manager, long n_buckets) {
+	free(manager->buckets);
+	free(manager->computed);
+	manager->n_buckets = n_buckets;
+	manager->buckets = malloc(n_buckets * sizeof(Bdd));
+	for (long i = 0; i < n_buckets; i++)
+		manager->buckets[i] = -1;
+	manager->computed = malloc(n_buckets * sizeof(struct ComputedEntry));
+	clear_computed(manager);
+	for (Bdd f = 2; f < manager->n_nodes; f++) {
+		struct BddNode *node = &manager->nodes[f];
+		if (node->level == -1)
+			continue;
+		long bucket = bucket_of(manager, node->level, node->low, node->high);
+		node->next = manager->buckets[bucket];
+		manager->buckets[bucket] = f;
+	}
+}
+
+/* Manager for BDDs of variables at levels 0 to n_levels - 1, with at most
+ * max_nodes nodes (at least the two constants).
+ */
+struct BddManager *bdd_new(int n_levels, long max_nodes) {
+	struct BddManager *manager = calloc(1, sizeof(struct BddManager));
+	manager->n_levels = n_levels;
+	manager->max_nodes = max_nodes < 2 ? 2 : max_nodes;
+	manager->cap_nodes = manager->max_nodes < MIN_BUCKETS ? manager->max_nodes : MIN_BUCKETS;
+	manager->nodes = malloc(manager->cap_nodes * sizeof(struct BddNode));
+	for (Bdd f = BDD_FALSE; f <= BDD_TRUE; f++) {
+		struct BddNode *node = &manager->nodes[f];
+		node->level = n_levels;
+		node->low = node->high = f;
+		node->next = -1;
+		node->refs = 1; // never freed
+		node->marked = false;
+	}
+	manager->n_nodes = manager->live = 2;
+	manager->gc_at = manager->max_nodes / 2;
+	manager->free_list = -1;
+	rehash(manager, MIN_BUCKETS);
+	return manager;
+}
+
+void bdd_free(struct BddManager *manager) {
+	free(manager->computed);
+	free(manager->buckets);
+	free(manager->nodes);
+	free(manager);
+}
+
+/* Did an operation need more than max_nodes nodes?
+ */
+bool bdd_overflowed(struct BddManager *manager) {
+	return manager->overflow;
+}
+
+long bdd_live_nodes(struct BddManager *manager) {
+	return manager->live;
+}
+
+/* The node with level, low and high, made if there is none. As the
+ * diagrams are reduced, there is no node of which low and high are the
+ * same. Return BDD_FALSE and overflow the manager if it is full.
+ */
+static Bdd make_node(struct BddManager *manager, int level, Bdd low, Bdd high) {
+	if (low == high)
+		return low;
+	long bucket = bucket_of(manager, level, low, high);
+	for (Bdd f = manager->buckets[bucket]; f != -1; f = manager->nodes[f].next) {
+		struct BddNode *node = &manager->nodes[f];
+		if (node->level == level && node->low == low && node->high == high)
+			return f;
+	}
+	Bdd f = manager->free_list;
+	if (f != -1) {
+		manager->free_list = manager->nodes[f].next;
+	} else {
+		if (manager->n_nodes == manager->cap_nodes) {
+			if (manager->cap_nodes == manager->max_nodes) {
+				manager->overflow = true;
+				return BDD_FALSE;
+			}
+			manager->cap_nodes *= 2;
+			if (manager->cap_nodes > manager->max_nodes)
+				manager->cap_nodes = manager->max_nodes;
+			manager->nodes = realloc(manager->nodes, manager->cap_nodes * sizeof(struct BddNode));
+		}
+		f = manager->n_nodes++;
+	}
+	struct BddNode *node = &manager->nodes[f];
+	node->level = level;
+	node->low = low;
+	node->high = high;
+	node->refs = 0;
+	node->marked = false;
+	node->next = manager->buckets[bucket];
+	manager->buckets[bucket] = f;
+	if (++manager->live > 2 * manager->n_buckets)
+		rehash(manager, 2 * manager->n_buckets);
+	return f;
+}
+
+/* The BDD of the variable at level.
+ */
+Bdd bdd_var(struct BddManager *manager, int level) {
+	return make_node(manager, level, BDD_FALSE, BDD_TRUE);
+}
+
+/* The cofactors of f where the variable at level is F and T.
+ */
+static void cofactors(struct BddManager *manager, Bdd f, int level, Bdd *low, Bdd *high) {
+	struct BddNode *node = &manager->nodes[f];
+	if (node->level == level) {
+		*low = node->low;
+		*high = node->high;
+	} else {
+		*low = *high = f;
+	}
+}
+
+static int min_level(int level1, int level2) {
+	return level1 < level2 ? level1 : level2;
+}
+
+/* If f then g else h, which all other operations are made of.
+ */
+Bdd bdd_ite(struct BddManager *manager, Bdd f, Bdd g, Bdd h) {
+	if (manager->overflow)
+		return BDD_FALSE;
+	if (f == BDD_TRUE || g == h)
+		return g;
+	if (f == BDD_FALSE)
+		return h;
+	if (g == BDD_TRUE && h == BDD_FALSE)
+		return f;
+	struct ComputedEntry *entry =
+		&manager->computed[hash3(f, g, h) & (manager->n_buckets - 1)];
+	if (entry->f == f && entry->g == g && entry->h == h)
+		return entry->result;
+	int level = min_level(manager->nodes[f].level,
+			min_level(manager->nodes[g].level, manager->nodes[h].level));
+	Bdd f0, f1, g0, g1, h0, h1;
+	cofactors(manager, f, level, &f0, &f1);
+	cofactors(manager, g, level, &g0, &g1);
+	cofactors(manager, h, level, &h0, &h1);
+	Bdd low = bdd_ite(manager, f0, g0, h0);
+	Bdd high = bdd_ite(manager, f1, g1, h1);
+	Bdd result = make_node(manager, level, low, high);
+	if (manager->overflow)
+		return BDD_FALSE;
+	entry = &manager->computed[hash3(f, g, h) & (manager->n_buckets - 1)];
+	entry->f = f;
+	entry->g = g;
+	entry->h = h;
+	entry->result = result;
+	return result;
+}
+
+Bdd bdd_not(struct BddManager *manager, Bdd f) {
+	return bdd_ite(manager, f, BDD_FALSE, BDD_TRUE);
+}
+
+Bdd bdd_and(struct BddManager *manager, Bdd f, Bdd g) {
+	return bdd_ite(manager, f, g, BDD_FALSE);
+}
+
+Bdd bdd_or(struct BddManager *manager, Bdd f, Bdd g) {
+	return bdd_ite(manager, f, BDD_TRUE, g);
+}
+
+/* Keep f, and the nodes reachable from it, from being freed by bdd_gc.
+ */
+void bdd_ref(struct BddManager *manager, Bdd f) {
+	manager->nodes[f].refs++;
+}
+
+void bdd_deref(struct BddManager *manager, Bdd f) {
+	manager->nodes[f].refs--;
+}
+
+static void mark(struct BddManager *manager, Bdd f) {
+	struct BddNode *node = &manager->nodes[f];
+	if (node->marked)
+		return;
+	node->marked = true;
+	mark(manager, node->low);
+	mark(manager, node->high);
+}
+
+/* Free the nodes that are not reachable from BDDs held with bdd_ref.
+ * Other BDDs must not be used afterwards.
+ */
+void bdd_gc(struct BddManager *manager) {
+	for (Bdd f = 0; f < manager->n_nodes; f++)
+		if (manager->nodes[f].level != -1 && manager->nodes[f].refs > 0)
+			mark(manager, f);
+	for (Bdd f = 2; f < manager->n_nodes; f++) {
+		struct BddNode *node = &manager->nodes[f];
+		if (node->level != -1 && !node->marked) {
+			node->level = -1;
+			node->next = manager->free_list;
+			manager->free_list = f;
+			manager->live--;
+		}
+	}
+	for (Bdd f = 0; f < manager->n_nodes; f++)
+		manager->nodes[f].marked = false;
+	rehash(manager, manager->n_buckets);
+}
+
+static void order_vars(struct Expr *expr, int levels[], int *n_levels) {
+	switch (expr->tag) {
+		case isDisj:
+		case isConj:
+			order_vars(expr->expr1, levels, n_levels);
+			order_vars(expr->expr2, levels, n_levels);
+			break;
+		case isNeg:
+			order_vars(expr->expr1, levels, n_levels);
+			break;
+		case isVar:
+			if (levels[expr->var] == -1)
+				levels[expr->var] = (*n_levels)++;
+			break;
+		default:
+			break;
+	}
+}
+
+static int max_var(struct Expr *expr) {
+	switch (expr->tag) {
+		case isDisj:
+		case isConj: {
+			int var1 = max_var(expr->expr1);
+			int var2 = max_var(expr->expr2);
+			return var1 > var2 ? var1 : var2;
+		}
+		case isNeg:
+			return max_var(expr->expr1);
+		case isVar:
+			return expr->var;
+		default:
+			return -1;
+	}
+}
+
+/* Levels of the variables of exprs, in order of first occurrence, depth
+ * first. Return an array indexed by variable, up to the largest one in
+ * exprs, of which the entries of other variables are -1, and set
+ * *n_levels to the number of variables.
+ */
+int *bdd_order(struct Expr *exprs[], int n_exprs, int *n_levels) {
+	int n_vars = 0;
+	for (int i = 0; i < n_exprs; i++) {
+		int var = max_var(exprs[i]);
+		if (var + 1 > n_vars)
+			n_vars = var + 1;
+	}
+	int *levels = malloc((n_vars > 0 ? n_vars : 1) * sizeof(int));
+	for (int var = 0; var < n_vars; var++)
+		levels[var] = -1;
+	*n_levels = 0;
+	for (int i = 0; i < n_exprs; i++)
+		order_vars(exprs[i], levels, n_levels);
+	return levels;
+}
+
+/* The BDD of expr, of which the variables have levels.
+ */
+Bdd bdd_of_expr(struct BddManager *manager, struct Expr *expr, int levels[]) {
+	if (manager->overflow)
+		return BDD_FALSE;
+	switch (expr->tag) {
+		case isTrue:
+			return BDD_TRUE;
+		case isFalse:
+			return BDD_FALSE;
+		case isVar:
+			return bdd_var(manager, levels[expr->var]);
+		case isNeg:
+			return bdd_not(manager, bdd_of_expr(manager, expr->expr1, levels));
+		default:
+			break;
+	}
+	Bdd f = bdd_of_expr(manager, expr->expr1, levels);
+	bdd_ref(manager, f);
+	Bdd g = bdd_of_expr(manager, expr->expr2, levels);
+	bdd_ref(manager, g);
+	if (manager->live >= manager->gc_at) {
+		bdd_gc(manager);
+		manager->gc_at = manager->live + (manager->max_nodes - manager->live) / 2;
+	}
+	Bdd result = expr->tag == isDisj ? bdd_or(manager, f, g) : bdd_and(manager, f, g);
+	bdd_deref(manager, f);
+	bdd_deref(manager, g);
+	return result;
+}
+
+/* Is expr a tautology? Return 1 if it is, 0 if not, and -1 if this
+ * takes more than max_nodes nodes to tell.
+ */
+int bdd_tautology(struct Expr *expr, long max_nodes) {
+	int n_levels;
+	int *levels = bdd_order(&expr, 1, &n_levels);
+	struct BddManager *manager = bdd_new(n_levels, max_nodes);
+	Bdd f = bdd_of_expr(manager, expr, levels);
+	int res = manager->overflow ? -1 : f == BDD_TRUE;
+	bdd_free(manager);
+	free(levels);
+	return res;
+}
+
+/* Are expr1 and expr2 equivalent? Return 1 if they are, 0 if not, and
+ * -1 if this takes more than max_nodes nodes to tell.
+ */
+int bdd_equivalent(struct Expr *expr1, struct Expr *expr2, long max_nodes) {
+	struct Expr *exprs[] = {expr1, expr2};
+	int n_levels;
+	int *levels = bdd_order(exprs, 2, &n_levels);
+	struct BddManager *manager = bdd_new(n_levels, max_nodes);
+	Bdd f = bdd_of_expr(manager, expr1, levels);
+	bdd_ref(manager, f);
+	Bdd g = bdd_of_expr(manager, expr2, levels);
+	int res = manager->overflow ? -1 : f == g;
+	bdd_free(manager);
+	free(levels);
+	return res;
+}
@@ -0,0 +1,55 @@
+#ifndef BDD_H
+#define BDD_H
+
+#include <stdbool.h>
+
+#include "logic.h"
+
+/* Reduced ordered binary decision diagrams (BDDs), to tell whether an
+ * expression is a tautology, or whether two are equivalent, for more
+ * variables than truth tables allow. A BDD is canonical for the order of
+ * its variables, so these are checks of whether it is T, or whether two
+ * are the same node.
+ *
+ * A BDD is the index of its root node in its manager. Nodes are hash
+ * consed in a unique table, and the results of bdd_ite are kept in
+ * a computed table. A manager holds at most max_nodes nodes; when an
+ * operation would need more, the manager is overflowed, and the results
+ * of all later operations are meaningless. Nodes that are not reachable
+ * from BDDs held with bdd_ref are freed by bdd_gc, which bdd_of_expr
+ * calls by itself when the manager fills up.
+ *
+ * Variables are numbered by level, from the top of the diagrams.
+ * bdd_order gives the levels of the variables of expressions, in the
+ * order in which they are first met depth first, which keeps variables
+ * that occur near each other near each other in the order.
+ */
+typedef int Bdd;
+
+#define BDD_FALSE 0
+#define BDD_TRUE 1
+
+struct BddManager;
+
+struct BddManager *bdd_new(int n_levels, long max_nodes);
+void bdd_free(struct BddManager *manager);
+bool bdd_overflowed(struct BddManager *manager);
+long bdd_live_nodes(struct BddManager *manager);
+
+Bdd bdd_var(struct BddManager *manager, int level);
+Bdd bdd_ite(struct BddManager *manager, Bdd f, Bdd g, Bdd h);
+Bdd bdd_not(struct BddManager *manager, Bdd f);
+Bdd bdd_and(struct BddManager *manager, Bdd f, Bdd g);
+Bdd bdd_or(struct BddManager *manager, Bdd f, Bdd g);
+
+void bdd_ref(struct BddManager *manager, Bdd f);
+void bdd_deref(struct BddManager *manager, Bdd f);
+void bdd_gc(struct BddManager *manager);
+
+int *bdd_order(struct Expr *exprs[], int n_exprs, int *n_levels);
+Bdd bdd_of_expr(struct BddManager *manager, struct Expr *expr, int levels[]);
+
+int bdd_tautology(struct Expr *expr, long max_nodes);
+int bdd_equivalent(struct Expr *expr1, struct Expr *expr2, long max_nodes);
+
+#endif // BDD_H
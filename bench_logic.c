@@ -0,0 +1,410 @@
+#include <fcntl.h>
+#include <linux/perf_event.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "laws.h"
+#include "logic.h"
+#include "scan.h"
+
+/* Micro-benchmarks of the functions in logic.c and of searching and
+ * applying laws, on expressions of several shapes and sizes.
+ * Output is one line per benchmark and shape:
+ *   name shape nodes min median p90 max bytes/op misses/op
+ * with times in ns per operation, over a number of batches. Bytes are
+ * counted by wrapping malloc (link with -Wl,--wrap=malloc); cache misses
+ * are counted with perf where available, and are otherwise "n/a".
+ * scan_all_laws finds the positions of all laws of Part 1 with the
+ * kernel of match_kernel(), to compare with search_tag and search_equal,
+ * which find those of one law.
+ */
+
+#define BATCHES 51
+#define MIN_BATCH_NS 200000
+
+/*******************************************/
+/* Counting allocations.                   */
+/*******************************************/
+
+void *__real_malloc(size_t size);
+
+static long allocated = 0;
+
+void *__wrap_malloc(size_t size) {
+	allocated += size;
+	return __real_malloc(size);
+}
+
+/*******************************************/
+/* Cache misses.                           */
+/*******************************************/
+
+static int perf_fd = -1;
+
+static void open_perf() {
+	struct perf_event_attr attr;
+	memset(&attr, 0, sizeof(attr));
+	attr.type = PERF_TYPE_HARDWARE;
+	attr.size = sizeof(attr);
+	attr.config = PERF_COUNT_HW_CACHE_MISSES;
+	attr.disabled = 1;
+	attr.exclude_kernel = 1;
+	attr.exclude_hv = 1;
+	perf_fd = syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+}
+
+static long long read_misses() {
+	long long count = 0;
+	if (perf_fd < 0 || read(perf_fd, &count, sizeof(count)) != sizeof(count))
+		return -1;
+	return count;
+}
+
+/*******************************************/
+/* Shapes of expressions.                  */
+/*******************************************/
+
+struct Text {
+	char *buf;
+	size_t len;
+	size_t cap;
+};
+
+static void add(struct Text *text, char *str) {
+	size_t n = strlen(str);
+	while (text->len + n + 1 > text->cap) {
+		text->cap = text->cap == 0 ? 256 : 2 * text->cap;
+		text->buf = realloc(text->buf, text->cap);
+	}
+	memcpy(text->buf + text->len, str, n + 1);
+	text->len += n;
+}
+
+static int var_count = 0;
+
+static void add_var(struct Text *text) {
+	char var[2] = {'a' + var_count++ % 26, '\0'};
+	add(text, var);
+}
+
+/* Complete binary tree, alternating disjunction and conjunction.
+ */
+static void balanced(struct Text *text, int height) {
+	if (height == 0) {
+		add_var(text);
+		return;
+	}
+	add(text, "(");
+	balanced(text, height - 1);
+	add(text, height % 2 == 0 ? "|" : "&");
+	balanced(text, height - 1);
+	add(text, ")");
+}
+
+/* a|b&c|d&e|..., which is parsed left-deep.
+ */
+static void left_deep(struct Text *text, int leaves) {
+	for (int i = 0; i < leaves; i++) {
+		if (i > 0)
+			add(text, i % 2 == 0 ? "|" : "&");
+		add_var(text);
+	}
+}
+
+/* Balanced tree in which every subexpression is negated once or twice.
+ */
+static void negated(struct Text *text, int height) {
+	add(text, height % 2 == 0 ? "-" : "--");
+	if (height == 0) {
+		add_var(text);
+		return;
+	}
+	add(text, "(");
+	negated(text, height - 1);
+	add(text, height % 2 == 0 ? "|" : "&");
+	negated(text, height - 1);
+	add(text, ")");
+}
+
+/* Conjunction of many short clauses, as in CNF.
+ */
+static void wide(struct Text *text, int clauses) {
+	for (int i = 0; i < clauses; i++) {
+		if (i > 0)
+			add(text, "&");
+		add(text, "(");
+		add_var(text);
+		add(text, "|-");
+		add_var(text);
+		add(text, "|");
+		add_var(text);
+		add(text, ")");
+	}
+}
+
+/*******************************************/
+/* Benchmarks.                             */
+/*******************************************/
+
+/* The expression under test, and a copy of it.
+ */
+struct Subject {
+	char *name;
+	char *str;
+	struct Expr *expr;
+	struct Expr *copy;
+	int *path; // last position of commutativity of disjunction
+};
+
+typedef void (*Op)(struct Subject *subject);
+
+/* Reading is timed together with freeing the result,
+ * and so is copying.
+ */
+static void op_read(struct Subject *subject) {
+	free_expr(read_expr(subject->str));
+}
+
+static void op_print(struct Subject *subject) {
+	print_expr(subject->expr);
+}
+
+static void op_copy(struct Subject *subject) {
+	free_expr(copy_expr(subject->expr));
+}
+
+static void op_equal(struct Subject *subject) {
+	if (!equal_expr(subject->expr, subject->copy))
+		abort();
+}
+
+/* All positions of a law, as apply() does.
+ */
+static void search_all(struct Subject *subject, int law) {
+	int *path = non_path();
+	while (path != NULL) {
+		int *next = law_searches[law](subject->expr, path);
+		free_path(path);
+		path = next;
+	}
+}
+
+static void op_search_tag(struct Subject *subject) {
+	search_all(subject, 0); // commutativity disj: only looks at tags
+}
+
+static void op_search_equal(struct Subject *subject) {
+	search_all(subject, 12); // complementation disj: compares subexpressions
+}
+
+/* Positions of all laws of Part 1 at once, with a node array.
+ */
+static struct NodeArray scan_array;
+static struct LawInfo *scan_infos[32];
+
+static void op_scan(struct Subject *subject) {
+	flatten_expr(subject->expr, &scan_array);
+	match_laws(&scan_array, scan_infos, n_laws());
+	for (int law = 0; law < n_laws(); law++)
+		for (int i = next_match(&scan_array, scan_infos[law], law, 0); i != -1;
+				i = next_match(&scan_array, scan_infos[law], law, i + 1))
+			;
+}
+
+static void op_apply(struct Subject *subject) {
+	free_expr(law_applies[0](subject->expr, subject->path));
+}
+
+static long long now_ns() {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+static int compare_doubles(const void *a, const void *b) {
+	double x = *(const double *) a;
+	double y = *(const double *) b;
+	return (x > y) - (x < y);
+}
+
+/* Time op in batches; store sorted ns per op of each batch in times,
+ * and return bytes allocated per op and misses per op (-1 if unknown).
+ */
+static void measure(Op op, struct Subject *subject, double *times,
+		double *bytes, double *misses) {
+	long batch = 1;
+	while (true) {
+		long long start = now_ns();
+		for (long i = 0; i < batch; i++)
+			op(subject);
+		if (now_ns() - start >= MIN_BATCH_NS)
+			break;
+		batch *= 2;
+	}
+	long start_allocated = allocated;
+	long long total_misses = 0;
+	for (int b = 0; b < BATCHES; b++) {
+		if (perf_fd >= 0) {
+			ioctl(perf_fd, PERF_EVENT_IOC_RESET, 0);
+			ioctl(perf_fd, PERF_EVENT_IOC_ENABLE, 0);
+		}
+		long long start = now_ns();
+		for (long i = 0; i < batch; i++)
+			op(subject);
+		times[b] = (double) (now_ns() - start) / batch;
+		if (perf_fd >= 0) {
+			ioctl(perf_fd, PERF_EVENT_IOC_DISABLE, 0);
+			long long m = read_misses();
+			total_misses = m < 0 || total_misses < 0 ? -1 : total_misses + m;
+		}
+	}
+	qsort(times, BATCHES, sizeof(double), compare_doubles);
+	*bytes = (double) (allocated - start_allocated) / (BATCHES * batch);
+	*misses = perf_fd < 0 || total_misses < 0 ? -1 : (double) total_misses / (BATCHES * batch);
+}
+
+static void report(char *name, struct Subject *subject, double *times,
+		double bytes, double misses) {
+	printf("%-14s %-9s %6d %10.1f %10.1f %10.1f %10.1f %10.1f ",
+			name, subject->name, size_expr(subject->expr), times[0],
+			times[BATCHES / 2], times[BATCHES * 9 / 10], times[BATCHES - 1], bytes);
+	if (misses < 0)
+		printf("%10s\n", "n/a");
+	else
+		printf("%10.2f\n", misses);
+}
+
+static void bench(char *name, Op op, struct Subject *subject) {
+	double times[BATCHES];
+	double bytes, misses;
+	measure(op, subject, times, &bytes, &misses);
+	report(name, subject, times, bytes, misses);
+}
+
+/* Freeing needs expressions to free, which are copied before each
+ * batch, outside of the timing.
+ */
+static void bench_free(struct Subject *subject) {
+	long batch = 1;
+	while (true) {
+		long long start = now_ns();
+		for (long i = 0; i < batch; i++)
+			free_expr(copy_expr(subject->expr));
+		if (now_ns() - start >= MIN_BATCH_NS)
+			break;
+		batch *= 2;
+	}
+	struct Expr **copies = malloc(batch * sizeof(struct Expr *));
+	double times[BATCHES];
+	long long total_misses = 0;
+	for (int b = 0; b < BATCHES; b++) {
+		for (long i = 0; i < batch; i++)
+			copies[i] = copy_expr(subject->expr);
+		if (perf_fd >= 0) {
+			ioctl(perf_fd, PERF_EVENT_IOC_RESET, 0);
+			ioctl(perf_fd, PERF_EVENT_IOC_ENABLE, 0);
+		}
+		long long start = now_ns();
+		for (long i = 0; i < batch; i++)
+			free_expr(copies[i]);
+		times[b] = (double) (now_ns() - start) / batch;
+		if (perf_fd >= 0) {
+			ioctl(perf_fd, PERF_EVENT_IOC_DISABLE, 0);
+			long long m = read_misses();
+			total_misses = m < 0 || total_misses < 0 ? -1 : total_misses + m;
+		}
+	}
+	free(copies);
+	qsort(times, BATCHES, sizeof(double), compare_doubles);
+	report("free_expr", subject, times, 0,
+			perf_fd < 0 || total_misses < 0 ? -1 : (double) total_misses / (BATCHES * batch));
+}
+
+static void run_subject(char *name, struct Text *text) {
+	struct Subject subject;
+	subject.name = name;
+	subject.str = text->buf;
+	subject.expr = read_expr(text->buf);
+	subject.copy = copy_expr(subject.expr);
+	int *path = non_path();
+	subject.path = NULL;
+	while (path != NULL) {
+		int *next = law_searches[0](subject.expr, path);
+		if (next == NULL)
+			subject.path = path;
+		else
+			free_path(path);
+		path = next;
+	}
+
+	bench("read_expr", op_read, &subject);
+	// printing goes to /dev/null
+	double times[BATCHES];
+	double bytes, misses;
+	fflush(stdout);
+	int saved = dup(1);
+	int null_fd = open("/dev/null", O_WRONLY);
+	dup2(null_fd, 1);
+	measure(op_print, &subject, times, &bytes, &misses);
+	fflush(stdout);
+	dup2(saved, 1);
+	close(saved);
+	close(null_fd);
+	report("print_expr", &subject, times, bytes, misses);
+	bench("copy_expr", op_copy, &subject);
+	bench("equal_expr", op_equal, &subject);
+	bench_free(&subject);
+	bench("search_tag", op_search_tag, &subject);
+	bench("search_equal", op_search_equal, &subject);
+	bench("scan_all_laws", op_scan, &subject);
+	if (subject.path != NULL && subject.path[0] != -1)
+		bench("apply_law", op_apply, &subject);
+
+	free_path(subject.path);
+	free_expr(subject.expr);
+	free_expr(subject.copy);
+	free(text->buf);
+	text->buf = NULL;
+	text->len = text->cap = 0;
+}
+
+/* Usage: bench_logic [scale]
+ * Scale 1 (the default) gives expressions of about 64 and 1024 nodes.
+ */
+int main(int argc, char **argv) {
+	int scale = argc > 1 ? atoi(argv[1]) : 1;
+	if (scale < 1 || scale > 4) {
+		fprintf(stderr, "Usage: %s [scale 1-4]\n", argv[0]);
+		return 2;
+	}
+	open_perf();
+	for (int law = 0; law < n_laws(); law++)
+		scan_infos[law] = law_info(law_searches[law]);
+	printf("%-14s %-9s %6s %10s %10s %10s %10s %10s %10s\n", "name", "shape",
+			"nodes", "min_ns", "median_ns", "p90_ns", "max_ns", "bytes/op", "misses/op");
+	for (int size = 0; size < 2; size++) {
+		int height = (size == 0 ? 5 : 9) + scale - 1;
+		struct Text text = {NULL, 0, 0};
+		var_count = 0;
+		balanced(&text, height);
+		run_subject("balanced", &text);
+		var_count = 0;
+		left_deep(&text, 1 << height);
+		run_subject("left-deep", &text);
+		var_count = 0;
+		negated(&text, height - 1);
+		run_subject("negated", &text);
+		var_count = 0;
+		wide(&text, (1 << height) / 6);
+		run_subject("wide", &text);
+	}
+	if (perf_fd >= 0)
+		close(perf_fd);
+	return 0;
+}
@@ -0,0 +1,766 @@
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "bfs.h"
+#include "serial.h"
+
+/* Most files merged at once; more runs are merged in more passes.
+ */
+#define MAX_MERGE 64
+
+/* Bytes of the stdio buffer of each file, for sequential reads and writes.
+ */
+#define FILE_BUFFER (1 << 16)
+
+/*******************************************/
+/* Files of sorted encodings.              */
+/*******************************************/
+
+/* Order of encodings: by their bytes, and a prefix first.
+ */
+static int compare_records(const unsigned char *rec1, size_t len1,
+		const unsigned char *rec2, size_t len2) {
+	int cmp = memcmp(rec1, rec2, len1 < len2 ? len1 : len2);
+	if (cmp != 0)
+		return cmp;
+	return (len1 > len2) - (len1 < len2);
+}
+
+static void put_varint(FILE *file, size_t n) {
+	while (n >= 0x80) {
+		putc((n & 0x7f) | 0x80, file);
+		n >>= 7;
+	}
+	putc(n, file);
+}
+
+static bool get_varint(FILE *file, size_t *n) {
+	*n = 0;
+	for (int shift = 0; shift < 64; shift += 7) {
+		int c = getc(file);
+		if (c == EOF)
+			return false;
+		*n |= (size_t) (c & 0x7f) << shift;
+		if (!(c & 0x80))
+			return true;
+	}
+	return false;
+}
+
+struct RunWriter {
+	FILE *file;
+	unsigned char *prev;
+	size_t prev_len;
+	size_t prev_cap;
+	long n_records;
+};
+
+static bool open_writer(struct RunWriter *writer, char *path) {
+	memset(writer, 0, sizeof(struct RunWriter));
+	writer->file = fopen(path, "wb");
+	if (writer->file != NULL)
+		setvbuf(writer->file, NULL, _IOFBF, FILE_BUFFER);
+	return writer->file != NULL;
+}
+
+/* Write record, which comes after the one before it in order, front coded.
+ */
+static void write_record(struct RunWriter *writer, const unsigned char *rec, size_t len) {
+	size_t shared = 0;
+	while (shared < len && shared < writer->prev_len && rec[shared] == writer->prev[shared])
+		shared++;
+	put_varint(writer->file, shared);
+	put_varint(writer->file, len - shared);
+	fwrite(rec + shared, 1, len - shared, writer->file);
+	if (len > writer->prev_cap) {
+		writer->prev_cap = 2 * len;
+		writer->prev = realloc(writer->prev, writer->prev_cap);
+	}
+	memcpy(writer->prev + shared, rec + shared, len - shared);
+	writer->prev_len = len;
+	writer->n_records++;
+}
+
+/* Close writer, adding the bytes of its file to *bytes.
+ * Return whether all was written.
+ */
+static bool close_writer(struct RunWriter *writer, long *bytes) {
+	bool ok = !ferror(writer->file);
+	long size = ftell(writer->file);
+	if (size > 0)
+		*bytes += size;
+	ok = fclose(writer->file) == 0 && ok;
+	free(writer->prev);
+	return ok;
+}
+
+struct RunReader {
+	FILE *file;
+	unsigned char *rec; // the current record, if not done
+	size_t len;
+	size_t cap;
+	bool done;
+};
+
+/* Read the next record into reader->rec, or set reader->done.
+ */
+static void next_record(struct RunReader *reader) {
+	size_t shared, rest;
+	if (reader->done || !get_varint(reader->file, &shared) ||
+			!get_varint(reader->file, &rest) || shared > reader->len) {
+		reader->done = true;
+		return;
+	}
+	if (shared + rest > reader->cap) {
+		reader->cap = 2 * (shared + rest);
+		reader->rec = realloc(reader->rec, reader->cap);
+	}
+	if (fread(reader->rec + shared, 1, rest, reader->file) != rest)
+		reader->done = true;
+	reader->len = shared + rest;
+}
+
+static bool open_reader(struct RunReader *reader, char *path) {
+	memset(reader, 0, sizeof(struct RunReader));
+	reader->file = fopen(path, "rb");
+	if (reader->file == NULL)
+		return false;
+	setvbuf(reader->file, NULL, _IOFBF, FILE_BUFFER);
+	next_record(reader);
+	return true;
+}
+
+static void close_reader(struct RunReader *reader) {
+	fclose(reader->file);
+	free(reader->rec);
+}
+
+/* Merge the sorted files inputs into the sorted file out, once each,
+ * leaving out those in the sorted files excluded. Return the number of
+ * records written, or -1 if a file could not be read or written.
+ */
+static long merge_files(char *inputs[], int n_inputs, char *excluded[], int n_excluded,
+		char *out, long *bytes) {
+	struct RunReader readers[n_inputs + n_excluded];
+	struct RunWriter writer;
+	int n_open = 0;
+	bool ok = open_writer(&writer, out);
+	for (; ok && n_open < n_inputs + n_excluded; n_open++)
+		ok = open_reader(&readers[n_open], n_open < n_inputs ? inputs[n_open] :
+				excluded[n_open - n_inputs]);
+	struct RunReader *excluding = readers + n_inputs;
+	while (ok) {
+		struct RunReader *min = NULL;
+		for (int i = 0; i < n_inputs; i++)
+			if (!readers[i].done && (min == NULL ||
+					compare_records(readers[i].rec, readers[i].len, min->rec, min->len) < 0))
+				min = &readers[i];
+		if (min == NULL)
+			break;
+		bool seen = false;
+		for (int i = 0; i < n_excluded && !seen; i++) {
+			int cmp = -1;
+			while (!excluding[i].done && (cmp = compare_records(excluding[i].rec,
+					excluding[i].len, min->rec, min->len)) < 0)
+				next_record(&excluding[i]);
+			seen = !excluding[i].done && cmp == 0;
+		}
+		if (!seen)
+			write_record(&writer, min->rec, min->len);
+		// the same record may be in other inputs, and is then left out there too
+		for (int i = 0; i < n_inputs; i++)
+			if (&readers[i] != min && !readers[i].done &&
+					compare_records(readers[i].rec, readers[i].len, min->rec, min->len) == 0)
+				next_record(&readers[i]);
+		next_record(min);
+	}
+	for (int i = 0; i < n_open - (ok ? 0 : 1); i++)
+		close_reader(&readers[i]);
+	if (writer.file != NULL)
+		ok = close_writer(&writer, bytes) && ok;
+	return ok ? writer.n_records : -1;
+}
+
+/*******************************************/
+/* Runs.                                   */
+/*******************************************/
+
+/* Encodings made by expanding a level, each stored as its length
+ * (4 bytes) and its bytes, until they fill memory.
+ */
+struct RunBuffer {
+	unsigned char *data;
+	size_t used;
+	size_t cap;
+	unsigned char **records;
+	long n_records;
+	long cap_records;
+};
+
+/* A run being sorted and written by a thread.
+ */
+struct Flush {
+	pthread_t thread;
+	bool busy;
+	struct RunBuffer *buffer;
+	char path[4096];
+	long bytes;
+	bool ok;
+};
+
+static uint32_t record_len(const unsigned char *record) {
+	uint32_t len;
+	memcpy(&len, record, sizeof(len));
+	return len;
+}
+
+static int compare_buffered(const void *ptr1, const void *ptr2) {
+	const unsigned char *record1 = *(unsigned char *const *) ptr1;
+	const unsigned char *record2 = *(unsigned char *const *) ptr2;
+	return compare_records(record1 + 4, record_len(record1), record2 + 4, record_len(record2));
+}
+
+/* Sort the records of flush->buffer and write them, once each, to
+ * flush->path.
+ */
+static void *write_run(void *arg) {
+	struct Flush *flush = arg;
+	struct RunBuffer *buffer = flush->buffer;
+	qsort(buffer->records, buffer->n_records, sizeof(unsigned char *), compare_buffered);
+	struct RunWriter writer;
+	flush->ok = open_writer(&writer, flush->path);
+	if (flush->ok) {
+		for (long i = 0; i < buffer->n_records; i++)
+			if (i == 0 || compare_buffered(&buffer->records[i - 1], &buffer->records[i]) != 0)
+				write_record(&writer, buffer->records[i] + 4, record_len(buffer->records[i]));
+		flush->ok = close_writer(&writer, &flush->bytes);
+	}
+	buffer->used = 0;
+	buffer->n_records = 0;
+	return NULL;
+}
+
+/* Wait for the run being written, if any. Return whether it was written.
+ */
+static bool wait_flush(struct Flush *flush, struct BfsStats *stats) {
+	if (!flush->busy)
+		return true;
+	pthread_join(flush->thread, NULL);
+	flush->busy = false;
+	stats->bytes += flush->bytes;
+	flush->bytes = 0;
+	return flush->ok;
+}
+
+/* State of the expansion of a level.
+ */
+struct Expansion {
+	struct RunBuffer buffers[2];
+	int filling; // buffer being filled
+	struct Flush flush;
+	char *dir;
+	int level;   // being made
+	int n_runs;
+	bool ok;
+	struct BfsStats *stats;
+};
+
+static void run_path(char *path, char *dir, int level, int run) {
+	snprintf(path, 4096, "%s/run-%d-%d", dir, level, run);
+}
+
+static void level_path(char *path, char *dir, int level) {
+	snprintf(path, 4096, "%s/level-%d", dir, level);
+}
+
+/* Write the buffer being filled as a run, in a thread, and go on with the
+ * other buffer when the run before is written.
+ */
+static void flush_buffer(struct Expansion *expansion) {
+	struct RunBuffer *buffer = &expansion->buffers[expansion->filling];
+	if (buffer->n_records == 0)
+		return;
+	struct Flush *flush = &expansion->flush;
+	if (!wait_flush(flush, expansion->stats))
+		expansion->ok = false;
+	flush->buffer = buffer;
+	run_path(flush->path, expansion->dir, expansion->level, expansion->n_runs++);
+	expansion->stats->runs++;
+	flush->busy = pthread_create(&flush->thread, NULL, write_run, flush) == 0;
+	if (!flush->busy)
+		write_run(flush);
+	expansion->filling = 1 - expansion->filling;
+}
+
+static void add_record(struct Expansion *expansion, unsigned char *rec, size_t len) {
+	struct RunBuffer *buffer = &expansion->buffers[expansion->filling];
+	if (buffer->n_records > 0 && (buffer->used + 4 + len > buffer->cap ||
+			buffer->n_records == buffer->cap_records)) {
+		flush_buffer(expansion);
+		buffer = &expansion->buffers[expansion->filling];
+	}
+	if (4 + len > buffer->cap) { // one that does not fit at all gets a buffer of its own
+		buffer->cap = 4 + len;
+		buffer->data = realloc(buffer->data, buffer->cap);
+	}
+	unsigned char *record = buffer->data + buffer->used;
+	uint32_t len32 = len;
+	memcpy(record, &len32, 4);
+	memcpy(record + 4, rec, len);
+	buffer->used += 4 + len;
+	buffer->records[buffer->n_records++] = record;
+}
+
+/*******************************************/
+/* Search.                                 */
+/*******************************************/
+
+/* Start of a search, and the work since the clock was last read.
+ */
+struct Clock {
+	struct timespec start;
+	long work;
+};
+
+static void start_clock(struct Clock *clock) {
+	clock_gettime(CLOCK_MONOTONIC, &clock->start);
+	clock->work = CLOCK_WORK; // the clock is read at the first state
+}
+
+/* Whether max_millis (if not 0) have passed, read after CLOCK_WORK.
+ */
+static bool out_of_time(struct Clock *clock, long max_millis) {
+	if (max_millis <= 0 || clock->work < CLOCK_WORK)
+		return false;
+	clock->work = 0;
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	long millis = (now.tv_sec - clock->start.tv_sec) * 1000 +
+			(now.tv_nsec - clock->start.tv_nsec) / 1000000;
+	return millis >= max_millis;
+}
+
+/* Expand the expressions of level file into runs of expansion. Return
+ * whether one of them leads to T in one step.
+ */
+static bool expand_level(char *path, LawSearch searches[], LawApplication applies[],
+		int n_laws, struct Expansion *expansion, struct BfsOptions *options,
+		struct Clock *clock) {
+	struct RunReader reader;
+	if (!open_reader(&reader, path)) {
+		expansion->ok = false;
+		return false;
+	}
+	bool found = false;
+	struct BfsStats *stats = expansion->stats;
+	for (; !reader.done && !found && !stats->exceeded && expansion->ok; next_record(&reader)) {
+		if ((options->max_states > 0 && stats->states >= options->max_states) ||
+				out_of_time(clock, options->max_millis)) {
+			stats->exceeded = true;
+			break;
+		}
+		stats->states++;
+		struct Expr *expr = serial_decode_expr(reader.rec, reader.len);
+		if (expr == NULL) {
+			expansion->ok = false;
+			break;
+		}
+		clock->work += (long) expr->size * expr->size + CLOCK_WORK / 256;
+		int *path = non_path();
+		for (int i = 0; i < n_laws && !found && !stats->exceeded; i++) {
+			int *cur_path = searches[i](expr, path);
+			while (cur_path != NULL && !found && !stats->exceeded) {
+				struct Expr *next = applies[i](expr, cur_path);
+				clock->work += next->size;
+				if (out_of_time(clock, options->max_millis))
+					stats->exceeded = true;
+				else if (next->tag == isTrue) {
+					found = true;
+				} else {
+					normalize_vars(next);
+					size_t len;
+					unsigned char *rec = serial_encode_expr(next, &len);
+					add_record(expansion, rec, len);
+					free(rec);
+				}
+				free_expr(next);
+				int *next_path = found || stats->exceeded ? NULL : searches[i](expr, cur_path);
+				free_path(cur_path);
+				cur_path = next_path;
+			}
+			free_path(cur_path);
+		}
+		free_path(path);
+		free_expr(expr);
+	}
+	close_reader(&reader);
+	return found;
+}
+
+/* Merge the runs of the level being made into its level file, leaving
+ * out the expressions of the levels before it. Return the number of
+ * expressions in it, or -1 if this fails.
+ */
+static long merge_level(struct Expansion *expansion) {
+	char *dir = expansion->dir;
+	int level = expansion->level;
+	char paths[MAX_MERGE + expansion->level][4096];
+	char *inputs[MAX_MERGE];
+	char *excluded[expansion->level];
+	int n_runs = expansion->n_runs;
+	int pass = 0;
+	// merge groups of runs into fewer runs until they can be merged at once
+	while (n_runs > MAX_MERGE) {
+		int n_merged = 0;
+		for (int first = 0; first < n_runs; first += MAX_MERGE, n_merged++) {
+			int n = n_runs - first < MAX_MERGE ? n_runs - first : MAX_MERGE;
+			for (int i = 0; i < n; i++) {
+				run_path(paths[i], dir, level, first + i);
+				inputs[i] = paths[i];
+			}
+			char out[4096];
+			snprintf(out, sizeof(out), "%s/merge-%d-%d-%d", dir, level, pass, n_merged);
+			if (merge_files(inputs, n, NULL, 0, out, &expansion->stats->bytes) == -1)
+				return -1;
+			for (int i = 0; i < n; i++)
+				unlink(inputs[i]);
+			run_path(paths[0], dir, level, n_merged);
+			if (rename(out, paths[0]) != 0) {
+				unlink(out);
+				return -1;
+			}
+		}
+		n_runs = n_merged;
+		pass++;
+	}
+	for (int i = 0; i < n_runs; i++) {
+		run_path(paths[i], dir, level, i);
+		inputs[i] = paths[i];
+	}
+	for (int i = 0; i < level; i++) {
+		level_path(paths[MAX_MERGE + i], dir, i);
+		excluded[i] = paths[MAX_MERGE + i];
+	}
+	char out[4096];
+	level_path(out, dir, level);
+	long n = merge_files(inputs, n_runs, excluded, level, out, &expansion->stats->bytes);
+	for (int i = 0; i < n_runs; i++)
+		unlink(inputs[i]);
+	return n;
+}
+
+/*******************************************/
+/* Approximate search in memory.           */
+/*******************************************/
+
+/* Bits set in the filter for each expression.
+ */
+#define FILTER_HASHES 4
+
+/* Largest bound on the chance that the filter cut a derivation for which
+ * a result is not marked approximate.
+ */
+#define MAX_DOUBT 1e-9
+
+/* Bloom filter of the 64-bit hashes of the expressions of earlier levels.
+ */
+struct Filter {
+	unsigned char *bits;
+	unsigned long long n_bits;
+	unsigned long long n_set; // bits set
+};
+
+/* 64-bit hash of an encoding: FNV-1a, mixed so that both halves can be
+ * used for the positions of the bits.
+ */
+static unsigned long long hash_record(const unsigned char *rec, size_t len) {
+	unsigned long long h = 0xcbf29ce484222325ULL;
+	for (size_t i = 0; i < len; i++) {
+		h ^= rec[i];
+		h *= 0x100000001b3ULL;
+	}
+	h ^= h >> 33;
+	h *= 0xff51afd7ed558ccdULL;
+	h ^= h >> 33;
+	return h;
+}
+
+/* Add the encoding to filter, or with add false, tell whether it may be
+ * in it.
+ */
+static bool filter_bits(struct Filter *filter, const unsigned char *rec, size_t len, bool add) {
+	unsigned long long hash = hash_record(rec, len);
+	unsigned long long step = (hash >> 32) | 1;
+	for (int i = 0; i < FILTER_HASHES; i++) {
+		unsigned long long bit = (hash + i * step) % filter->n_bits;
+		if (add && !(filter->bits[bit / 8] & 1 << bit % 8)) {
+			filter->bits[bit / 8] |= 1 << bit % 8;
+			filter->n_set++;
+		} else if (!add && !(filter->bits[bit / 8] & 1 << bit % 8)) {
+			return false;
+		}
+	}
+	return true;
+}
+
+/* Expressions of a level held in memory, each as its length (4 bytes)
+ * and its bytes, in order once it is made.
+ */
+struct MemLevel {
+	unsigned char **records;
+	long n_records;
+	long cap_records;
+};
+
+static void add_mem_record(struct MemLevel *level, unsigned char *rec, size_t len,
+		size_t *bytes) {
+	if (level->n_records == level->cap_records) {
+		level->cap_records = level->cap_records == 0 ? 256 : 2 * level->cap_records;
+		level->records = realloc(level->records, level->cap_records * sizeof(unsigned char *));
+	}
+	unsigned char *record = malloc(4 + len);
+	uint32_t len32 = len;
+	memcpy(record, &len32, 4);
+	memcpy(record + 4, rec, len);
+	level->records[level->n_records++] = record;
+	*bytes += 4 + len + sizeof(unsigned char *);
+}
+
+/* Sort level and drop its duplicates.
+ */
+static void finish_mem_level(struct MemLevel *level, size_t *bytes) {
+	qsort(level->records, level->n_records, sizeof(unsigned char *), compare_buffered);
+	long n = 0;
+	for (long i = 0; i < level->n_records; i++) {
+		unsigned char *record = level->records[i];
+		if (n > 0 && compare_buffered(&level->records[n - 1], &record) == 0) {
+			*bytes -= 4 + record_len(record) + sizeof(unsigned char *);
+			free(record);
+		} else {
+			level->records[n++] = record;
+		}
+	}
+	level->n_records = n;
+}
+
+static bool in_mem_level(struct MemLevel *level, unsigned char *record) {
+	return bsearch(&record, level->records, level->n_records, sizeof(unsigned char *),
+			compare_buffered) != NULL;
+}
+
+static void free_mem_level(struct MemLevel *level, size_t *bytes) {
+	for (long i = 0; i < level->n_records; i++) {
+		*bytes -= 4 + record_len(level->records[i]) + sizeof(unsigned char *);
+		free(level->records[i]);
+	}
+	free(level->records);
+	memset(level, 0, sizeof(struct MemLevel));
+}
+
+/* As bfs_derivation, with the last three levels in memory, and the
+ * levels before them only in a Bloom filter. An expression is left out
+ * if it is in one of the last two levels, or if the filter says it may
+ * be in an earlier one. The chances that the filter was wrong, which are
+ * the fill of the filter to the power of FILTER_HASHES, are summed, and
+ * the result is marked approximate if the sum is more than MAX_DOUBT.
+ */
+static int approximate_derivation(struct Expr *expr, int max_depth, LawSearch searches[],
+		LawApplication applies[], int n_laws, struct BfsOptions *options,
+		struct BfsStats *stats) {
+	struct Filter filter;
+	filter.n_bits = 8ULL * options->filter_bytes;
+	filter.bits = calloc(options->filter_bytes, 1);
+	if (filter.bits == NULL) {
+		stats->exceeded = true;
+		return -1;
+	}
+	struct Clock clock;
+	start_clock(&clock);
+	struct MemLevel prev = {0}, cur = {0}, next = {0};
+	size_t bytes = 0;
+
+	struct Expr *first = copy_expr(expr);
+	normalize_vars(first);
+	size_t len;
+	unsigned char *rec = serial_encode_expr(first, &len);
+	add_mem_record(&cur, rec, len, &bytes);
+	filter_bits(&filter, rec, len, true);
+	free(rec);
+	free_expr(first);
+
+	int res = -1;
+	for (int level = 0; level + 1 < max_depth && cur.n_records > 0 && res == -1 &&
+			!stats->exceeded; level++) {
+		for (long r = 0; r < cur.n_records && res == -1 && !stats->exceeded; r++) {
+			if ((options->max_states > 0 && stats->states >= options->max_states) ||
+					(options->memory > 0 && bytes > options->memory) ||
+					out_of_time(&clock, options->max_millis)) {
+				stats->exceeded = true;
+				break;
+			}
+			stats->states++;
+			struct Expr *cur_expr = serial_decode_expr(cur.records[r] + 4,
+					record_len(cur.records[r]));
+			clock.work += (long) cur_expr->size * cur_expr->size + CLOCK_WORK / 256;
+			int *path = non_path();
+			for (int i = 0; i < n_laws && res == -1 && !stats->exceeded; i++) {
+				int *cur_path = searches[i](cur_expr, path);
+				while (cur_path != NULL && res == -1 && !stats->exceeded) {
+					struct Expr *next_expr = applies[i](cur_expr, cur_path);
+					clock.work += next_expr->size;
+					if (out_of_time(&clock, options->max_millis)) {
+						stats->exceeded = true;
+					} else if (next_expr->tag == isTrue) {
+						res = level + 1;
+					} else {
+						normalize_vars(next_expr);
+						rec = serial_encode_expr(next_expr, &len);
+						unsigned char record[4 + len];
+						uint32_t len32 = len;
+						memcpy(record, &len32, 4);
+						memcpy(record + 4, rec, len);
+						if (in_mem_level(&cur, record) || in_mem_level(&prev, record))
+							;
+						else if (filter_bits(&filter, rec, len, false)) {
+							// chance that this is a false positive
+							double fill = (double) filter.n_set / filter.n_bits;
+							double doubt = 1;
+							for (int h = 0; h < FILTER_HASHES; h++)
+								doubt *= fill;
+							stats->doubt += doubt;
+							stats->pruned++;
+						}
+						else
+							add_mem_record(&next, rec, len, &bytes);
+						free(rec);
+					}
+					free_expr(next_expr);
+					int *next_path = res == -1 && !stats->exceeded ?
+							searches[i](cur_expr, cur_path) : NULL;
+					free_path(cur_path);
+					cur_path = next_path;
+				}
+				free_path(cur_path);
+			}
+			free_path(path);
+			free_expr(cur_expr);
+		}
+		finish_mem_level(&next, &bytes);
+		for (long r = 0; r < next.n_records; r++)
+			filter_bits(&filter, next.records[r] + 4, record_len(next.records[r]), true);
+		if ((long) bytes > stats->bytes)
+			stats->bytes = bytes;
+		free_mem_level(&prev, &bytes);
+		prev = cur;
+		cur = next;
+		memset(&next, 0, sizeof(struct MemLevel));
+	}
+	free_mem_level(&prev, &bytes);
+	free_mem_level(&cur, &bytes);
+	free_mem_level(&next, &bytes);
+	free(filter.bits);
+	stats->approximate = stats->doubt > MAX_DOUBT;
+	return stats->exceeded ? -1 : res;
+}
+
+/**
+ * Shortest derivation of T from expr of fewer than max_depth steps, as
+ * apply finds, or -1 if there is none, found breadth first with the
+ * levels on disk, or with options->filter_bytes, in memory with a filter.
+ * If a limit of options is reached, or a file cannot be made,
+ * stats->exceeded is set and -1 is returned.
+ */
+int bfs_derivation(struct Expr *expr, int max_depth, LawSearch searches[],
+		LawApplication applies[], int n_laws, struct BfsOptions *options,
+		struct BfsStats *stats) {
+	memset(stats, 0, sizeof(struct BfsStats));
+	if (expr->tag == isTrue)
+		return max_depth > 0 ? 0 : -1;
+	if (options->filter_bytes > 0)
+		return approximate_derivation(expr, max_depth, searches, applies, n_laws, options,
+				stats);
+	char dir[4096];
+	snprintf(dir, sizeof(dir), "%s/bfs-XXXXXX", options->dir);
+	if (mkdtemp(dir) == NULL) {
+		stats->exceeded = true;
+		return -1;
+	}
+	struct Clock clock;
+	start_clock(&clock);
+
+	struct Expansion expansion;
+	memset(&expansion, 0, sizeof(expansion));
+	expansion.dir = dir;
+	expansion.stats = stats;
+	expansion.ok = true;
+	for (int b = 0; b < 2; b++) {
+		struct RunBuffer *buffer = &expansion.buffers[b];
+		buffer->cap = options->memory > 4096 ? options->memory : 4096;
+		buffer->data = malloc(buffer->cap);
+		buffer->cap_records = buffer->cap / 16;
+		buffer->records = malloc(buffer->cap_records * sizeof(unsigned char *));
+	}
+
+	// level 0 is the expression itself
+	struct Expr *first = copy_expr(expr);
+	normalize_vars(first);
+	size_t len;
+	unsigned char *rec = serial_encode_expr(first, &len);
+	add_record(&expansion, rec, len);
+	free(rec);
+	free_expr(first);
+	flush_buffer(&expansion);
+	expansion.ok = wait_flush(&expansion.flush, stats);
+	long n_level = merge_level(&expansion);
+	if (n_level == -1)
+		expansion.ok = false;
+
+	int res = -1;
+	for (int level = 0; level + 1 < max_depth && n_level > 0 && expansion.ok; level++) {
+		char path[4096];
+		level_path(path, dir, level);
+		expansion.level = level + 1;
+		expansion.n_runs = 0;
+		bool found = expand_level(path, searches, applies, n_laws, &expansion, options, &clock);
+		flush_buffer(&expansion);
+		if (!wait_flush(&expansion.flush, stats))
+			expansion.ok = false;
+		if (found) {
+			res = level + 1;
+			for (int i = 0; i < expansion.n_runs; i++) {
+				run_path(path, dir, level + 1, i);
+				unlink(path);
+			}
+			break;
+		}
+		if (stats->exceeded || !expansion.ok)
+			break;
+		n_level = merge_level(&expansion);
+		if (n_level == -1)
+			expansion.ok = false;
+	}
+	if (!expansion.ok)
+		stats->exceeded = true;
+
+	for (int level = 0; level < max_depth; level++) {
+		char path[4096];
+		level_path(path, dir, level);
+		unlink(path);
+	}
+	for (int i = 0; i < expansion.n_runs; i++) { // left by a failure
+		char path[4096];
+		run_path(path, dir, expansion.level, i);
+		unlink(path);
+	}
+	rmdir(dir);
+	for (int b = 0; b < 2; b++) {
+		free(expansion.buffers[b].data);
+		free(expansion.buffers[b].records);
+	}
+	return stats->exceeded ? -1 : res;
+}
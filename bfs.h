@@ -0,0 +1,63 @@
+#ifndef BFS_H
+#define BFS_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "laws.h"
+#include "logic.h"
+
+/* Work after which the clock is read, here and in the searches of
+ * simplify.c. Expanding a state of n nodes counts n * n and
+ * CLOCK_WORK / 256, so that the clock is read at least every 256 states,
+ * and making each child of n nodes counts n, so that it is also read
+ * while expanding a large expression.
+ */
+#define CLOCK_WORK (1L << 20)
+
+/* Breadth-first search for a derivation, with the frontier on disk, for
+ * depths at which the expressions reached do not fit in memory.
+ *
+ * The expressions of each level are kept in a file in a directory, as
+ * their encodings (see serial_encode_expr, with the variables renamed by
+ * normalize_vars, which does not change the number of steps to T),
+ * sorted and front coded: each one is stored as the length of the prefix
+ * it shares with the one before it, and the rest. A level is made by
+ * expanding the one before it into sorted runs of at most memory bytes,
+ * which are written by a thread while the expansion goes on, and then
+ * merging the runs, leaving out duplicates and the expressions of all
+ * levels before it.
+ *
+ * With filter_bytes, there are no files: the last three levels are kept
+ * in memory, in at most memory bytes, and the levels before them only
+ * in a Bloom filter of filter_bytes bytes over 64-bit hashes of the
+ * encodings. An expression the filter says may have been reached before
+ * is left out, so a false positive of the filter can cut the shortest
+ * derivation. If the chance of that, bounded by the fill of the filter at
+ * each expression left out, is not negligible, the result is marked
+ * approximate: a derivation of that many steps exists, but there may be
+ * a shorter one, or one at all if the result is -1.
+ */
+struct BfsOptions {
+	char *dir;        // where the files are made, in a directory of their own
+	size_t memory;    // for the expressions of a run, twice as runs are written while expanding
+	long max_states;  // expressions expanded, 0 for no limit
+	long max_millis;  // wall-clock time, 0 for no limit
+	size_t filter_bytes; // search in memory with a filter of this size, 0 for files in dir
+};
+
+struct BfsStats {
+	long states;      // expressions expanded
+	long runs;        // sorted runs written
+	long bytes;       // written to files in all, or most held in memory with a filter
+	bool exceeded;    // a limit was reached, or a file could not be made
+	long pruned;      // expressions left out as the filter may have had them
+	double doubt;     // bound on the chance that one of them was not in it
+	bool approximate; // the bound is not small, so the result may not be the shortest
+};
+
+int bfs_derivation(struct Expr *expr, int max_depth, LawSearch searches[],
+		LawApplication applies[], int n_laws, struct BfsOptions *options,
+		struct BfsStats *stats);
+
+#endif // BFS_H
@@ -0,0 +1,117 @@
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "cache.h"
+
+/* Number of consecutive slots in which a key may be found.
+ */
+#define WINDOW 8
+
+struct CacheSlot {
+	unsigned char *key; // NULL if empty
+	size_t len;
+	unsigned long long hash;
+	int result;
+};
+
+struct ResultCache {
+	pthread_mutex_t lock;
+	struct CacheSlot *slots;
+	size_t cap;
+	size_t victim; // next slot to be replaced in a full window
+	long hits;
+	long misses;
+	long entries;
+};
+
+/* FNV-1a.
+ */
+static unsigned long long hash_key(const unsigned char *key, size_t len) {
+	unsigned long long h = 0xcbf29ce484222325ULL;
+	for (size_t i = 0; i < len; i++) {
+		h ^= key[i];
+		h *= 0x100000001b3ULL;
+	}
+	return h;
+}
+
+/* Capacity is rounded up to a power of two.
+ */
+struct ResultCache *cache_new(size_t capacity) {
+	struct ResultCache *cache = calloc(1, sizeof(struct ResultCache));
+	cache->cap = WINDOW;
+	while (cache->cap < capacity)
+		cache->cap *= 2;
+	cache->slots = calloc(cache->cap, sizeof(struct CacheSlot));
+	pthread_mutex_init(&cache->lock, NULL);
+	return cache;
+}
+
+static struct CacheSlot *find_slot(struct ResultCache *cache, const unsigned char *key,
+		size_t len, unsigned long long hash) {
+	for (size_t i = 0; i < WINDOW; i++) {
+		struct CacheSlot *slot = &cache->slots[(hash + i) & (cache->cap - 1)];
+		if (slot->key != NULL && slot->hash == hash && slot->len == len &&
+				memcmp(slot->key, key, len) == 0)
+			return slot;
+	}
+	return NULL;
+}
+
+bool cache_get(struct ResultCache *cache, const unsigned char *key, size_t len, int *result) {
+	unsigned long long hash = hash_key(key, len);
+	pthread_mutex_lock(&cache->lock);
+	struct CacheSlot *slot = find_slot(cache, key, len, hash);
+	if (slot != NULL) {
+		*result = slot->result;
+		cache->hits++;
+	} else {
+		cache->misses++;
+	}
+	pthread_mutex_unlock(&cache->lock);
+	return slot != NULL;
+}
+
+void cache_put(struct ResultCache *cache, const unsigned char *key, size_t len, int result) {
+	unsigned long long hash = hash_key(key, len);
+	pthread_mutex_lock(&cache->lock);
+	struct CacheSlot *slot = find_slot(cache, key, len, hash);
+	for (size_t i = 0; slot == NULL && i < WINDOW; i++) {
+		struct CacheSlot *empty = &cache->slots[(hash + i) & (cache->cap - 1)];
+		if (empty->key == NULL)
+			slot = empty;
+	}
+	if (slot == NULL) {
+		slot = &cache->slots[(hash + cache->victim++ % WINDOW) & (cache->cap - 1)];
+		free(slot->key);
+		slot->key = NULL;
+		cache->entries--;
+	}
+	if (slot->key == NULL) {
+		slot->key = malloc(len > 0 ? len : 1);
+		memcpy(slot->key, key, len);
+		slot->len = len;
+		slot->hash = hash;
+		cache->entries++;
+	}
+	slot->result = result;
+	pthread_mutex_unlock(&cache->lock);
+}
+
+void cache_stats(struct ResultCache *cache, long *hits, long *misses, long *entries) {
+	pthread_mutex_lock(&cache->lock);
+	*hits = cache->hits;
+	*misses = cache->misses;
+	*entries = cache->entries;
+	pthread_mutex_unlock(&cache->lock);
+}
+
+void cache_free(struct ResultCache *cache) {
+	for (size_t i = 0; i < cache->cap; i++)
+		free(cache->slots[i].key);
+	free(cache->slots);
+	pthread_mutex_destroy(&cache->lock);
+	free(cache);
+}
@@ -0,0 +1,19 @@
+#ifndef CACHE_H
+#define CACHE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+/* Table from keys (strings of bytes) to results of searches.
+ * It has a fixed capacity; when full, older entries are replaced.
+ * It can be shared between threads.
+ */
+struct ResultCache;
+
+struct ResultCache *cache_new(size_t capacity);
+bool cache_get(struct ResultCache *cache, const unsigned char *key, size_t len, int *result);
+void cache_put(struct ResultCache *cache, const unsigned char *key, size_t len, int result);
+void cache_stats(struct ResultCache *cache, long *hits, long *misses, long *entries);
+void cache_free(struct ResultCache *cache);
+
+#endif // CACHE_H
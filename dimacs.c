@@ -0,0 +1,225 @@
+#include <fcntl.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "dimacs.h"
+
+/* Balanced expression built from operands given one at a time, as
+ * a binary counter: the stack holds expressions of 2^k operands for
+ * decreasing k, and two of the same count are joined as soon as there
+ * are. It holds at most one expression per bit of the number of operands.
+ */
+struct Balancer {
+	struct Expr *(*join)(struct Expr *expr1, struct Expr *expr2);
+	struct Expr *exprs[64];
+	long counts[64];
+	int n;
+};
+
+static void balance_add(struct Balancer *balancer, struct Expr *expr) {
+	long count = 1;
+	while (balancer->n > 0 && balancer->counts[balancer->n - 1] == count) {
+		balancer->n--;
+		expr = balancer->join(balancer->exprs[balancer->n], expr);
+		count *= 2;
+	}
+	balancer->exprs[balancer->n] = expr;
+	balancer->counts[balancer->n++] = count;
+}
+
+/* Join the expressions on the stack, or return NULL if there are none.
+ */
+static struct Expr *balance_end(struct Balancer *balancer) {
+	if (balancer->n == 0)
+		return NULL;
+	struct Expr *expr = balancer->exprs[--balancer->n];
+	while (balancer->n > 0)
+		expr = balancer->join(balancer->exprs[--balancer->n], expr);
+	return expr;
+}
+
+static void balance_free(struct Balancer *balancer) {
+	while (balancer->n > 0)
+		free_expr(balancer->exprs[--balancer->n]);
+}
+
+/* State of reading a mapped file.
+ */
+struct DimacsReader {
+	const char *file_name;
+	const char *start;
+	const char *p;
+	const char *end;
+	int line;
+};
+
+static void skip_line(struct DimacsReader *reader) {
+	while (reader->p < reader->end && *reader->p != '\n')
+		reader->p++;
+}
+
+/* Skip white space, and comment lines. Return the next character, or
+ * 0 at the end.
+ */
+static char skip_space(struct DimacsReader *reader) {
+	bool line_start = reader->p == reader->start || reader->p[-1] == '\n';
+	while (reader->p < reader->end) {
+		char c = *reader->p;
+		if (c == '\n') {
+			reader->line++;
+			line_start = true;
+		} else if (line_start && c == 'c') {
+			skip_line(reader);
+			continue;
+		} else if (c != ' ' && c != '\t' && c != '\r') {
+			return c;
+		} else {
+			line_start = false;
+		}
+		reader->p++;
+	}
+	return 0;
+}
+
+static bool read_number(struct DimacsReader *reader, long *n) {
+	bool neg = reader->p < reader->end && *reader->p == '-';
+	if (neg)
+		reader->p++;
+	if (reader->p == reader->end || *reader->p < '0' || *reader->p > '9')
+		return false;
+	*n = 0;
+	while (reader->p < reader->end && *reader->p >= '0' && *reader->p <= '9') {
+		*n = 10 * *n + (*reader->p++ - '0');
+		if (*n > 1L << 40)
+			return false;
+	}
+	if (neg)
+		*n = -*n;
+	return true;
+}
+
+static bool read_word(struct DimacsReader *reader, const char *word) {
+	skip_space(reader);
+	for (; *word != '\0'; word++, reader->p++)
+		if (reader->p == reader->end || *reader->p != *word)
+			return false;
+	return true;
+}
+
+/* Variables of up to this number are kept in a table once interned, so
+ * that each is interned once. Larger ones are interned at each literal.
+ */
+#define MAX_CACHED_VARS (1L << 20)
+
+/* Symbols of the variables xn seen so far, by n - 1, or -1.
+ * The table grows with the numbers in the file, not those of the header.
+ */
+struct VarCache {
+	int *vars;
+	long n;
+};
+
+static struct Expr *make_dimacs_var(long n, struct VarCache *cache) {
+	if (n > cache->n && n <= MAX_CACHED_VARS) {
+		long size = cache->n > 0 ? 2 * cache->n : 64;
+		while (size < n)
+			size *= 2;
+		if (size > MAX_CACHED_VARS)
+			size = MAX_CACHED_VARS;
+		cache->vars = realloc(cache->vars, size * sizeof(int));
+		for (long i = cache->n; i < size; i++)
+			cache->vars[i] = -1;
+		cache->n = size;
+	}
+	if (n <= cache->n && cache->vars[n - 1] != -1)
+		return make_var(cache->vars[n - 1]);
+	char name[32];
+	int len = snprintf(name, sizeof(name), "x%ld", n);
+	int var = intern_symbol(name, len);
+	if (n <= cache->n)
+		cache->vars[n - 1] = var;
+	return make_var(var);
+}
+
+/* Read the formula from the mapped file. Errors are reported on
+ * standard error.
+ */
+static struct Expr *read_formula(struct DimacsReader *reader) {
+	long n_vars, n_clauses;
+	if (skip_space(reader) != 'p' || !read_word(reader, "p") || !read_word(reader, "cnf") ||
+			(skip_space(reader), !read_number(reader, &n_vars)) ||
+			(skip_space(reader), !read_number(reader, &n_clauses)) ||
+			n_vars < 0 || n_clauses < 0) {
+		fprintf(stderr, "%s:%d: expected p cnf vars clauses\n", reader->file_name, reader->line);
+		return NULL;
+	}
+	struct VarCache vars = {NULL, 0};
+	struct Balancer clauses = {make_conj, {0}, {0}, 0};
+	struct Balancer literals = {make_disj, {0}, {0}, 0};
+	long n_read = 0;
+	bool ok = true;
+	char c;
+	while (ok && (c = skip_space(reader)) != 0 && c != '%') {
+		long n;
+		if (!read_number(reader, &n)) {
+			fprintf(stderr, "%s:%d: unexpected %c\n", reader->file_name, reader->line, c);
+			ok = false;
+		} else if (n == 0) {
+			struct Expr *clause = balance_end(&literals);
+			balance_add(&clauses, clause != NULL ? clause : make_false());
+			n_read++;
+		} else {
+			struct Expr *var = make_dimacs_var(n > 0 ? n : -n, &vars);
+			balance_add(&literals, n > 0 ? var : make_neg(var));
+		}
+	}
+	if (ok && literals.n > 0) {
+		fprintf(stderr, "%s:%d: clause not ended by 0\n", reader->file_name, reader->line);
+		ok = false;
+	}
+	if (ok && n_read != n_clauses)
+		fprintf(stderr, "%s: %ld clauses, not %ld as in the header\n", reader->file_name,
+				n_read, n_clauses);
+	free(vars.vars);
+	balance_free(&literals);
+	if (!ok) {
+		balance_free(&clauses);
+		return NULL;
+	}
+	struct Expr *expr = balance_end(&clauses);
+	return expr != NULL ? expr : make_true();
+}
+
+/* Read the formula in DIMACS file, or return NULL if it cannot be read.
+ * Errors are reported on standard error.
+ */
+struct Expr *read_dimacs(const char *file_name) {
+	int fd = open(file_name, O_RDONLY);
+	struct stat st;
+	if (fd == -1 || fstat(fd, &st) == -1) {
+		perror(file_name);
+		if (fd != -1)
+			close(fd);
+		return NULL;
+	}
+	const char *data = "";
+	if (st.st_size > 0) {
+		data = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+		if (data == MAP_FAILED) {
+			perror(file_name);
+			close(fd);
+			return NULL;
+		}
+		madvise((void *) data, st.st_size, MADV_SEQUENTIAL);
+	}
+	close(fd);
+	struct DimacsReader reader = {file_name, data, data, data + st.st_size, 1};
+	struct Expr *expr = read_formula(&reader);
+	if (st.st_size > 0)
+		munmap((void *) data, st.st_size);
+	return expr;
+}
@@ -0,0 +1,23 @@
+#ifndef DIMACS_H
+#define DIMACS_H
+
+#include "logic.h"
+
+/* Reading of formulas in conjunctive normal form in the DIMACS format:
+ * lines of comments starting with 'c', a header "p cnf vars clauses",
+ * and clauses as lists of nonzero numbers ended by 0, where n stands for
+ * the variable xn and -n for its negation. A line starting with '%', as
+ * some benchmark files end with, ends the formula.
+ *
+ * The file is mapped into memory and read once, and each clause is
+ * added to the conjunction as soon as it is read, so that only the
+ * expression itself is held, and a table of the variables seen. The
+ * counts of the header are only checked against the file, not trusted
+ * for sizes. The conjunction of the clauses, and the
+ * disjunction of the literals of each clause, are balanced, as their
+ * depth is that of the working trees of the search. An empty clause is
+ * F, and a formula without clauses is T.
+ */
+struct Expr *read_dimacs(const char *file_name);
+
+#endif // DIMACS_H
@@ -0,0 +1,83 @@
+#include <stdbool.h>
+#include <stdlib.h>
+
+#include "greedy.h"
+#include "laws.h"
+#include "logic.h"
+
+/* Apply the first law that makes the expression smaller, at the first
+ * position where it applies. Return NULL if there is none.
+ */
+static struct Expr *shrink_step(struct Expr *expr,
+		LawSearch searches[], LawApplication applies[], int n_laws) {
+	int *path = non_path();
+	struct Expr *next = NULL;
+	for (int i = 0; i < n_laws && next == NULL; i++) {
+		struct LawInfo *info = law_info(searches[i]);
+		if (info == NULL || info->kind != lawShrink)
+			continue;
+		int *found = searches[i](expr, path);
+		if (found != NULL) {
+			next = applies[i](expr, found);
+			free_path(found);
+		}
+	}
+	free_path(path);
+	return next;
+}
+
+/* Apply a law that reorders the expression, such that afterwards a law
+ * applies that makes it smaller, and apply that one too.
+ * Return NULL if there is no such pair of steps.
+ */
+static struct Expr *reorder_and_shrink(struct Expr *expr,
+		LawSearch searches[], LawApplication applies[], int n_laws) {
+	for (int i = 0; i < n_laws; i++) {
+		struct LawInfo *info = law_info(searches[i]);
+		if (info == NULL || info->kind != lawReorder)
+			continue;
+		int *path = non_path();
+		int *found;
+		while ((found = searches[i](expr, path)) != NULL) {
+			free_path(path);
+			path = found;
+			struct Expr *reordered = applies[i](expr, path);
+			struct Expr *next = shrink_step(reordered, searches, applies, n_laws);
+			free_expr(reordered);
+			if (next != NULL) {
+				free_path(path);
+				return next;
+			}
+		}
+		free_path(path);
+	}
+	return NULL;
+}
+
+/* Find a derivation of T quickly, by rewriting greedily with the laws that
+ * make the expression smaller, reordering only to enable such a law.
+ * Return the number of steps, or -1 if none is found within max_steps.
+ * The derivation need not be the shortest, so the result is an upper bound
+ * for the exact search.
+ */
+int greedy_derivation(struct Expr *expr, int max_steps,
+		LawSearch searches[], LawApplication applies[], int n_laws) {
+	struct Expr *cur = copy_expr(expr);
+	int steps = 0;
+	while (cur->tag != isTrue && steps < max_steps) {
+		struct Expr *next = shrink_step(cur, searches, applies, n_laws);
+		if (next != NULL) {
+			steps++;
+		} else if (steps + 2 <= max_steps) {
+			next = reorder_and_shrink(cur, searches, applies, n_laws);
+			steps += 2;
+		}
+		if (next == NULL)
+			break;
+		free_expr(cur);
+		cur = next;
+	}
+	bool found = cur->tag == isTrue;
+	free_expr(cur);
+	return found ? steps : -1;
+}
@@ -0,0 +1,10 @@
+#ifndef GREEDY_H
+#define GREEDY_H
+
+#include "laws.h"
+#include "logic.h"
+
+int greedy_derivation(struct Expr *expr, int max_steps,
+		LawSearch searches[], LawApplication applies[], int n_laws);
+
+#endif // GREEDY_H
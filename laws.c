@@ -1,9 +1,11 @@
 #include <stdbool.h>
 #include <stdlib.h>
 #include <stdio.h>
+#include <string.h>
 
 #include "laws.h"
 #include "logic.h"
+#include "trace.h"
 
 /* A path is an array of numbers referring to a subexpression
  * of a given expression. Cf. the concept of Gorn address.
@@ -14,10 +16,26 @@
  */
 int *non_path() {
 	int *path = malloc(sizeof(int));
+	MEM_COUNT(0, 1, sizeof(int));
 	path[0] = -1;
 	return path;
 }
 
+/* Free path made by non_path or by a search. Paths are counted by
+ * mem_accounting, so they should be freed with this.
+ */
+void free_path(int *path) {
+	if (path == NULL)
+		return;
+	if (mem_accounting) {
+		int length = 1;
+		while (path[length - 1] > 0)
+			length++;
+		mem_add(0, -1, -(long) (length * sizeof(int)));
+	}
+	free(path);
+}
+
 /* Non-path that doesn't need to be (should not be) freed.
  */
 static int NON_PATH[] = {-1};
@@ -214,6 +232,7 @@ static int *search_subexpression(struct Expr *expr, int *path, int depth,
 	if (path[0] == -1) {
 		if (pred(expr)) {
 			int *found_path = malloc((depth+1) * sizeof(int));
+			MEM_COUNT(0, 1, (depth+1) * sizeof(int));
 			found_path[depth] = 0;
 			return found_path;
 		}
@@ -516,12 +535,14 @@ static struct Expr *apply_idemp_conj_forward(struct Expr *expr){
 /* -(A|B) => -A&-B
  */
 static struct Expr *apply_mor_disj_forward(struct Expr *expr){
-	return make_conj(make_neg(copy_expr(expr->expr1)), make_neg(copy_expr(expr->expr2)));
+	return make_conj(make_neg(copy_expr(expr->expr1->expr1)),
+			make_neg(copy_expr(expr->expr1->expr2)));
 }
 /* -(A&B) => -A|-B
  */
 static struct Expr *apply_mor_conj_forward(struct Expr *expr){
-	return make_disj(make_neg(copy_expr(expr->expr1)), make_neg(copy_expr(expr->expr2)));
+	return make_disj(make_neg(copy_expr(expr->expr1->expr1)),
+			make_neg(copy_expr(expr->expr1->expr2)));
 }
 /*******************************************/
 /* END ADDED                               */
@@ -529,34 +550,40 @@ static struct Expr *apply_mor_conj_forward(struct Expr *expr){
 
 /* Transform subexpression at path.
  */
+/* Copy of a subexpression that the law leaves as it is.
+ */
+static struct Expr *copy_rest(struct Expr *expr) {
+	TRACE_BEGIN("copy", -1);
+	struct Expr *copy = copy_expr(expr);
+	TRACE_END("copy");
+	return copy;
+}
+
+/* Apply transform at the end of path, copying the rest of the expression.
+ * Return NULL if the path does not lead to a subexpression.
+ */
 static struct Expr *apply_law(struct Expr *expr, int *path,
 		struct Expr *(*transform)(struct Expr *)) {
-	if (path[0] == 0) {
+	if (path[0] == 0)
 		return transform(expr);
-	} else if (path[0] == 1) {
-		switch (expr->tag) {
-			case isDisj:
-				return make_disj(apply_law(expr->expr1, path+1, transform),
-									copy_expr(expr->expr2));
-			case isConj:
-				return make_conj(apply_law(expr->expr1, path+1, transform),
-									copy_expr(expr->expr2));
-			case isNeg:
-				return make_neg(apply_law(expr->expr1, path+1, transform));
-			default:
-				return NULL;
-		}
-	} else {
-		switch (expr->tag) {
-			case isDisj:
-				return make_disj(copy_expr(expr->expr1),
-									apply_law(expr->expr2, path+1, transform));
-			case isConj:
-				return make_conj(copy_expr(expr->expr1),
-									apply_law(expr->expr2, path+1, transform));
-			default:
-				return NULL;
-		}
+	struct Expr *sub;
+	if (path[0] == 1 && (expr->tag == isDisj || expr->tag == isConj || expr->tag == isNeg))
+		sub = apply_law(expr->expr1, path+1, transform);
+	else if (path[0] == 2 && (expr->tag == isDisj || expr->tag == isConj))
+		sub = apply_law(expr->expr2, path+1, transform);
+	else
+		return NULL;
+	if (sub == NULL)
+		return NULL;
+	switch (expr->tag) {
+		case isDisj:
+			return path[0] == 1 ? make_disj(sub, copy_rest(expr->expr2)) :
+					make_disj(copy_rest(expr->expr1), sub);
+		case isConj:
+			return path[0] == 1 ? make_conj(sub, copy_rest(expr->expr2)) :
+					make_conj(copy_rest(expr->expr1), sub);
+		default:
+			return make_neg(sub);
 	}
 }
 
@@ -653,6 +680,245 @@ struct Expr *apply_mor_conj_forward_at(struct Expr *expr, int *path){
 /* END ADDED                               */
 /*******************************************/
 
+/*******************************************/
+/* In-place rewriting.                     */
+/*******************************************/
+
+/* Node for a rewrite, from the free list if possible. It is recorded
+ * as fresh, so that it is freed when the rewrite is undone.
+ */
+static struct Expr *fresh_node(struct UndoLog *log, enum ExprTag tag,
+		struct Expr *expr1, struct Expr *expr2) {
+	struct Expr *expr = log->free_list;
+	if (expr != NULL)
+		log->free_list = expr->expr1;
+	else
+		expr = make_true(); // all nodes have the same size
+	expr->tag = tag;
+	expr->expr1 = expr1;
+	expr->expr2 = expr2;
+	if (tag != isVar)
+		fill_node(expr);
+	if (log->n_fresh == log->cap_fresh) {
+		log->cap_fresh = log->cap_fresh == 0 ? 64 : 2 * log->cap_fresh;
+		log->fresh = realloc(log->fresh, log->cap_fresh * sizeof(struct Expr *));
+	}
+	log->fresh[log->n_fresh++] = expr;
+	return expr;
+}
+
+/* Copy with fresh nodes, for laws that duplicate a subexpression,
+ * as the working tree must stay a tree.
+ */
+static struct Expr *fresh_copy(struct UndoLog *log, struct Expr *expr) {
+	switch (expr->tag) {
+		case isDisj:
+		case isConj:
+			return fresh_node(log, expr->tag, fresh_copy(log, expr->expr1),
+					fresh_copy(log, expr->expr2));
+		case isNeg:
+			return fresh_node(log, isNeg, fresh_copy(log, expr->expr1), NULL);
+		case isVar: {
+			struct Expr *copy = fresh_node(log, isVar, NULL, NULL);
+			copy->var = expr->var;
+			fill_node(copy);
+			return copy;
+		}
+		default:
+			return fresh_node(log, expr->tag, NULL, NULL);
+	}
+}
+
+/* A|B => B|A
+ */
+static struct Expr *rewrite_comm_disj_forward(struct Expr *expr, struct UndoLog *log) {
+	return fresh_node(log, isDisj, expr->expr2, expr->expr1);
+}
+
+/* A&B => B&A
+ */
+static struct Expr *rewrite_comm_conj_forward(struct Expr *expr, struct UndoLog *log) {
+	return fresh_node(log, isConj, expr->expr2, expr->expr1);
+}
+
+/* (A|B)|C => A|(B|C)
+ */
+static struct Expr *rewrite_assoc_disj_forward(struct Expr *expr, struct UndoLog *log) {
+	return fresh_node(log, isDisj, expr->expr1->expr1,
+			fresh_node(log, isDisj, expr->expr1->expr2, expr->expr2));
+}
+/* (A|B)|C <= A|(B|C)
+ */
+static struct Expr *rewrite_assoc_disj_backward(struct Expr *expr, struct UndoLog *log) {
+	return fresh_node(log, isDisj,
+			fresh_node(log, isDisj, expr->expr1, expr->expr2->expr1),
+			expr->expr2->expr2);
+}
+
+/* (A&B)&C => A&(B&C)
+ */
+static struct Expr *rewrite_assoc_conj_forward(struct Expr *expr, struct UndoLog *log) {
+	return fresh_node(log, isConj, expr->expr1->expr1,
+			fresh_node(log, isConj, expr->expr1->expr2, expr->expr2));
+}
+/* (A&B)&C <= A&(B&C)
+ */
+static struct Expr *rewrite_assoc_conj_backward(struct Expr *expr, struct UndoLog *log) {
+	return fresh_node(log, isConj,
+			fresh_node(log, isConj, expr->expr1, expr->expr2->expr1),
+			expr->expr2->expr2);
+}
+
+/* A|(B&C) => (A|B)&(A|C)
+ */
+static struct Expr *rewrite_distr_disj_forward(struct Expr *expr, struct UndoLog *log) {
+	return fresh_node(log, isConj,
+			fresh_node(log, isDisj, expr->expr1, expr->expr2->expr1),
+			fresh_node(log, isDisj, fresh_copy(log, expr->expr1), expr->expr2->expr2));
+}
+/* A|(B&C) <= (A|B)&(A|C)
+ */
+static struct Expr *rewrite_distr_disj_backward(struct Expr *expr, struct UndoLog *log) {
+	return fresh_node(log, isDisj, expr->expr1->expr1,
+			fresh_node(log, isConj, expr->expr1->expr2, expr->expr2->expr2));
+}
+
+/* A&(B|C) => (A&B)|(A&C)
+ */
+static struct Expr *rewrite_distr_conj_forward(struct Expr *expr, struct UndoLog *log) {
+	return fresh_node(log, isDisj,
+			fresh_node(log, isConj, expr->expr1, expr->expr2->expr1),
+			fresh_node(log, isConj, fresh_copy(log, expr->expr1), expr->expr2->expr2));
+}
+/* A&(B|C) <= (A&B)|(A&C)
+ */
+static struct Expr *rewrite_distr_conj_backward(struct Expr *expr, struct UndoLog *log) {
+	return fresh_node(log, isConj, expr->expr1->expr1,
+			fresh_node(log, isDisj, expr->expr1->expr2, expr->expr2->expr2));
+}
+
+/* A|(A&B) => A, A&(A|B) => A and A&A => A
+ */
+static struct Expr *rewrite_to_first(struct Expr *expr, struct UndoLog *log) {
+	(void) log;
+	return expr->expr1;
+}
+
+/* A|-A => T, A|T => T and -F => T
+ */
+static struct Expr *rewrite_to_true(struct Expr *expr, struct UndoLog *log) {
+	(void) expr;
+	return fresh_node(log, isTrue, NULL, NULL);
+}
+
+/* A&-A => F and A&F => F
+ */
+static struct Expr *rewrite_to_false(struct Expr *expr, struct UndoLog *log) {
+	(void) expr;
+	return fresh_node(log, isFalse, NULL, NULL);
+}
+
+/* --A => A
+ */
+static struct Expr *rewrite_dou_neg_forward(struct Expr *expr, struct UndoLog *log) {
+	(void) log;
+	return expr->expr1->expr1;
+}
+/* A => --A
+ */
+static struct Expr *rewrite_dou_neg_backward(struct Expr *expr, struct UndoLog *log) {
+	return fresh_node(log, isNeg, fresh_node(log, isNeg, expr, NULL), NULL);
+}
+
+/* -T <= T, as apply_f_neg_backward does
+ */
+static struct Expr *rewrite_f_neg_backward(struct Expr *expr, struct UndoLog *log) {
+	(void) expr;
+	return fresh_node(log, isNeg, fresh_node(log, isFalse, NULL, NULL), NULL);
+}
+
+/* -(A|B) => -A&-B
+ */
+static struct Expr *rewrite_mor_disj_forward(struct Expr *expr, struct UndoLog *log) {
+	return fresh_node(log, isConj, fresh_node(log, isNeg, expr->expr1->expr1, NULL),
+			fresh_node(log, isNeg, expr->expr1->expr2, NULL));
+}
+/* -(A&B) => -A|-B
+ */
+static struct Expr *rewrite_mor_conj_forward(struct Expr *expr, struct UndoLog *log) {
+	return fresh_node(log, isDisj, fresh_node(log, isNeg, expr->expr1->expr1, NULL),
+			fresh_node(log, isNeg, expr->expr1->expr2, NULL));
+}
+
+/* Rewrite the subexpression at path of the working tree at *root in
+ * place, and log it. The nodes above it are replaced by fresh ones, so
+ * that their cached fields are those of the new tree, and the old tree
+ * is left as it was. Return the new root, or NULL if the path does not
+ * lead to a subexpression.
+ */
+struct Expr *rewrite_at(struct UndoLog *log, struct Expr **root, int *path,
+		LawRewrite rewrite) {
+	int n = 0;
+	while (path[n] != 0)
+		n++;
+	struct Expr *above[n + 1];
+	above[0] = *root;
+	for (int i = 0; i < n; i++) {
+		struct Expr *expr = above[i];
+		if (path[i] == 1 && (expr->tag == isDisj || expr->tag == isConj || expr->tag == isNeg))
+			above[i + 1] = expr->expr1;
+		else if (path[i] == 2 && (expr->tag == isDisj || expr->tag == isConj))
+			above[i + 1] = expr->expr2;
+		else
+			return NULL;
+	}
+	if (log->n_undos == log->cap_undos) {
+		log->cap_undos = log->cap_undos == 0 ? 64 : 2 * log->cap_undos;
+		log->undos = realloc(log->undos, log->cap_undos * sizeof(struct Undo));
+	}
+	struct Undo *undo = &log->undos[log->n_undos++];
+	undo->slot = root;
+	undo->old = *root;
+	undo->n_fresh = log->n_fresh;
+	struct Expr *sub = rewrite(above[n], log);
+	for (int i = n - 1; i >= 0; i--) {
+		struct Expr *expr = above[i];
+		if (expr->tag == isNeg)
+			sub = fresh_node(log, isNeg, sub, NULL);
+		else if (path[i] == 1)
+			sub = fresh_node(log, expr->tag, sub, expr->expr2);
+		else
+			sub = fresh_node(log, expr->tag, expr->expr1, sub);
+	}
+	*root = sub;
+	return *root;
+}
+
+/* Undo the last rewrite in the log.
+ */
+void undo_rewrite(struct UndoLog *log) {
+	struct Undo *undo = &log->undos[--log->n_undos];
+	*undo->slot = undo->old;
+	while (log->n_fresh > undo->n_fresh) {
+		struct Expr *expr = log->fresh[--log->n_fresh];
+		expr->expr1 = log->free_list;
+		log->free_list = expr;
+	}
+}
+
+/* Free the free list and the log itself, after all rewrites are undone.
+ */
+void free_undo_log(struct UndoLog *log) {
+	while (log->free_list != NULL) {
+		struct Expr *expr = log->free_list;
+		log->free_list = expr->expr1;
+		free_node(expr);
+	}
+	free(log->undos);
+	free(log->fresh);
+	memset(log, 0, sizeof(struct UndoLog));
+}
+
 /*******************************************/
 /* For Part 1.                             */
 /*******************************************/
@@ -918,3 +1184,141 @@ char *cnf_law_names[] = {
 int n_cnf_laws() {
 	return sizeof(cnf_law_searches) / sizeof(LawSearch);
 }
+
+/*******************************************/
+/* What laws do, for heuristics.           */
+/*******************************************/
+
+#define X ANY_TAG
+
+static struct LawInfo law_infos[] = {
+	{search_comm_disj_lhs, lawReorder, {isDisj, X, X}, NULL, rewrite_comm_disj_forward},
+	{search_comm_conj_lhs, lawReorder, {isConj, X, X}, NULL, rewrite_comm_conj_forward},
+	{search_assoc_disj_lhs, lawReorder, {isDisj, isDisj, X}, NULL, rewrite_assoc_disj_forward},
+	{search_assoc_disj_rhs, lawReorder, {isDisj, X, isDisj}, NULL, rewrite_assoc_disj_backward},
+	{search_assoc_conj_lhs, lawReorder, {isConj, isConj, X}, NULL, rewrite_assoc_conj_forward},
+	{search_assoc_conj_rhs, lawReorder, {isConj, X, isConj}, NULL, rewrite_assoc_conj_backward},
+	{search_distr_disj_lhs, lawExpand, {isDisj, X, isConj}, NULL, rewrite_distr_disj_forward},
+	{search_distr_disj_rhs, lawShrink, {isConj, isDisj, isDisj}, is_distr_disj_rhs, rewrite_distr_disj_backward},
+	{search_distr_conj_lhs, lawExpand, {isConj, X, isDisj}, NULL, rewrite_distr_conj_forward},
+	{search_distr_conj_rhs, lawShrink, {isDisj, isConj, isConj}, is_distr_conj_rhs, rewrite_distr_conj_backward},
+	{search_abs_disj_lhs, lawShrink, {isDisj, X, isConj}, is_abs_disj_lhs, rewrite_to_first},
+	{search_abs_conj_lhs, lawShrink, {isConj, X, isDisj}, is_abs_conj_lhs, rewrite_to_first},
+	{search_compl_disj_lhs, lawShrink, {isDisj, X, isNeg}, is_compl_disj_lhs, rewrite_to_true},
+	{search_compl_conj_lhs, lawShrink, {isConj, X, isNeg}, is_compl_conj_lhs, rewrite_to_false},
+	{search_domi_conj_lhs, lawShrink, {isConj, X, isFalse}, NULL, rewrite_to_false},
+	{search_domi_disj_lhs, lawShrink, {isDisj, X, isTrue}, NULL, rewrite_to_true},
+	{search_dou_neg_lhs, lawShrink, {isNeg, isNeg, X}, NULL, rewrite_dou_neg_forward},
+	{search_dou_neg_rhs, lawExpand, {X, X, X}, NULL, rewrite_dou_neg_backward},
+	{search_f_neg_lhs, lawShrink, {isNeg, isFalse, X}, NULL, rewrite_to_true},
+	{search_f_neg_rhs, lawExpand, {isTrue, X, X}, NULL, rewrite_f_neg_backward},
+	{search_idemp_lhs, lawShrink, {isConj, X, X}, is_idemp_conj_lhs, rewrite_to_first},
+	{search_mor_disj_lhs, lawReorder, {isNeg, isDisj, X}, NULL, rewrite_mor_disj_forward},
+	{search_mor_conj_lhs, lawReorder, {isNeg, isConj, X}, NULL, rewrite_mor_conj_forward}
+};
+
+#undef X
+
+/* Find information on law with search function.
+ * Return NULL if there is none.
+ */
+struct LawInfo *law_info(LawSearch search) {
+	for (size_t i = 0; i < sizeof(law_infos) / sizeof(struct LawInfo); i++)
+		if (law_infos[i].search == search)
+			return &law_infos[i];
+	return NULL;
+}
+
+/* Does tag of child match pattern? A missing child only matches ANY_TAG.
+ */
+static bool child_matches(signed char pattern, struct Expr *child) {
+	return pattern == ANY_TAG || (child != NULL && pattern == (signed char) child->tag);
+}
+
+/* Does the law with info apply to expr itself (at path 0)? This is
+ * where its search finds it.
+ */
+bool law_matches(struct LawInfo *info, struct Expr *expr) {
+	struct Expr *expr1 = NULL;
+	struct Expr *expr2 = NULL;
+	if (expr->tag == isDisj || expr->tag == isConj || expr->tag == isNeg)
+		expr1 = expr->expr1;
+	if (expr->tag == isDisj || expr->tag == isConj)
+		expr2 = expr->expr2;
+	return (info->tags[0] == ANY_TAG || info->tags[0] == (signed char) expr->tag) &&
+		child_matches(info->tags[1], expr1) && child_matches(info->tags[2], expr2) &&
+		(info->check == NULL || info->check(expr));
+}
+
+/* Subexpression at path, or NULL if the path does not lead to one.
+ */
+struct Expr *subexpr_at(struct Expr *expr, int *path) {
+	for (int i = 0; path[i] != 0; i++) {
+		if (path[i] == 1 && (expr->tag == isDisj || expr->tag == isConj || expr->tag == isNeg))
+			expr = expr->expr1;
+		else if (path[i] == 2 && (expr->tag == isDisj || expr->tag == isConj))
+			expr = expr->expr2;
+		else
+			return NULL;
+	}
+	return expr;
+}
+
+/* Is the subexpression at path apart from that at other (neither is in
+ * the other), and to the left of it? Rewrites at positions apart from
+ * each other can be done in either order, with the same result.
+ */
+bool path_left_of(int *path, int *other) {
+	int i = 0;
+	while (path[i] != 0 && path[i] == other[i])
+		i++;
+	return path[i] != 0 && other[i] != 0 && path[i] < other[i];
+}
+
+/*******************************************/
+/* Law sets by name.                       */
+/*******************************************/
+
+struct LawSet law_sets[] = {
+	{"basic", law_searches, law_applies, law_names,
+		sizeof(law_searches) / sizeof(LawSearch), 6},
+	{"extra", extra_law_searches, extra_law_applies, extra_law_names,
+		sizeof(extra_law_searches) / sizeof(LawSearch), 6},
+	{"cnf", cnf_law_searches, cnf_law_applies, cnf_law_names,
+		sizeof(cnf_law_searches) / sizeof(LawSearch), 7}
+};
+
+int n_law_sets() {
+	return sizeof(law_sets) / sizeof(struct LawSet);
+}
+
+/* Find law set with name. Return NULL if there is none.
+ */
+struct LawSet *find_law_set(char *name) {
+	for (int i = 0; i < n_law_sets(); i++)
+		if (strcmp(law_sets[i].name, name) == 0)
+			return &law_sets[i];
+	return NULL;
+}
+
+/* Name of law with search function, in the first law set that has it.
+ * Return NULL if there is none.
+ */
+char *law_name(LawSearch search) {
+	for (int i = 0; i < n_law_sets(); i++)
+		for (int law = 0; law < law_sets[i].n_laws; law++)
+			if (law_sets[i].searches[law] == search)
+				return law_sets[i].names[law];
+	return NULL;
+}
+
+/* Search function of law with name in any law set.
+ * Return NULL if there is none.
+ */
+LawSearch find_law(char *name) {
+	for (int i = 0; i < n_law_sets(); i++)
+		for (int law = 0; law < law_sets[i].n_laws; law++)
+			if (strcmp(law_sets[i].names[law], name) == 0)
+				return law_sets[i].searches[law];
+	return NULL;
+}
@@ -4,6 +4,7 @@
 #include "logic.h"
 
 int *non_path();
+void free_path(int *path);
 
 void print_path(int *path);
 
@@ -37,4 +38,95 @@ extern LawApplication cnf_law_applies[];
 extern char* cnf_law_names[];
 extern int n_cnf_laws();
 
+/*******************************************/
+/* In-place rewriting.                     */
+/*******************************************/
+
+/* Log of the rewrites done in place on one working tree, so that they
+ * can be undone in reverse order. A rewrite replaces the subexpression
+ * at a path by one made of fresh nodes and of parts of the old one, and
+ * the nodes above it by fresh nodes, so that the old tree is left as it
+ * was and undoing it only needs to put back the old root and to free
+ * the fresh nodes. Freed nodes are kept
+ * on a free list, for later rewrites. A zeroed log is empty.
+ */
+struct Undo {
+	struct Expr **slot; // where the old root was
+	struct Expr *old;
+	int n_fresh;        // fresh nodes before the rewrite
+};
+
+struct UndoLog {
+	struct Undo *undos;
+	int n_undos;
+	int cap_undos;
+	struct Expr **fresh;
+	int n_fresh;
+	int cap_fresh;
+	struct Expr *free_list; // linked by expr1
+};
+
+/* Make the replacement of a subexpression to which a law applies,
+ * taking fresh nodes from the log.
+ */
+typedef struct Expr *(*LawRewrite)(struct Expr *expr, struct UndoLog *log);
+
+struct Expr *rewrite_at(struct UndoLog *log, struct Expr **root, int *path,
+		LawRewrite rewrite);
+void undo_rewrite(struct UndoLog *log);
+void free_undo_log(struct UndoLog *log);
+
+/*******************************************/
+/* What laws do, for heuristics.           */
+/*******************************************/
+
+/* Does the law (in the direction in which it is applied) only reorder
+ * the expression, make it larger, or make it smaller?
+ * De Morgan counts as reordering.
+ */
+enum LawKind {lawReorder, lawExpand, lawShrink};
+
+/* Where the law applies: tags of the node and of its first and second
+ * child that are needed (ANY_TAG if any will do, also none), and if
+ * the tags are not enough, the whole predicate, else NULL.
+ * The rewrite does in place what the application of the law does
+ * (the one paired with the search in the law sets).
+ */
+#define ANY_TAG -1
+
+struct LawInfo {
+	LawSearch search;
+	enum LawKind kind;
+	signed char tags[3];
+	bool (*check)(struct Expr *expr);
+	LawRewrite rewrite;
+};
+
+struct LawInfo *law_info(LawSearch search);
+bool law_matches(struct LawInfo *info, struct Expr *expr);
+struct Expr *subexpr_at(struct Expr *expr, int *path);
+bool path_left_of(int *path, int *other);
+
+/*******************************************/
+/* Law sets by name.                       */
+/*******************************************/
+
+/* The laws of one part, with the max depth used for them:
+ * "basic" for Part 1, "extra" for Part 2 and "cnf" for Part 3.
+ */
+struct LawSet {
+	char *name;
+	LawSearch *searches;
+	LawApplication *applies;
+	char **names;
+	int n_laws;
+	int max_depth;
+};
+
+extern struct LawSet law_sets[];
+extern int n_law_sets();
+struct LawSet *find_law_set(char *name);
+char *law_name(LawSearch search);
+LawSearch find_law(char *name);
+
 #endif // LAWS_H
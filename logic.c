@@ -1,3 +1,4 @@
+#include <pthread.h>
 #include <stdbool.h>
 #include <string.h>
 #include <stdio.h>
@@ -5,50 +6,261 @@
 
 #include "logic.h"
 
+/* Memory accounting, off by default.
+ */
+bool mem_accounting = false;
+__thread struct MemStats mem_stats;
+
+void mem_add(long nodes, long paths, long bytes) {
+	mem_stats.nodes += nodes;
+	mem_stats.paths += paths;
+	mem_stats.bytes += bytes;
+	if (mem_stats.nodes > mem_stats.peak_nodes)
+		mem_stats.peak_nodes = mem_stats.nodes;
+	if (mem_stats.paths > mem_stats.peak_paths)
+		mem_stats.peak_paths = mem_stats.paths;
+	if (mem_stats.bytes > mem_stats.peak_bytes)
+		mem_stats.peak_bytes = mem_stats.bytes;
+}
+
+/* Start a query, saving the counters of the thread in start.
+ * Peaks of the query are counted from the live values at this point.
+ */
+void mem_query_begin(struct MemStats *start) {
+	*start = mem_stats;
+	mem_stats.peak_nodes = mem_stats.nodes;
+	mem_stats.peak_paths = mem_stats.paths;
+	mem_stats.peak_bytes = mem_stats.bytes;
+}
+
+static long max_long(long x, long y) {
+	return x > y ? x : y;
+}
+
+/* End a query. Store in usage what is still live of the query (which has
+ * leaked) and the peaks of the query, both relative to start.
+ * Return whether anything has leaked.
+ */
+bool mem_query_end(struct MemStats *start, struct MemStats *usage) {
+	usage->nodes = mem_stats.nodes - start->nodes;
+	usage->paths = mem_stats.paths - start->paths;
+	usage->bytes = mem_stats.bytes - start->bytes;
+	usage->peak_nodes = mem_stats.peak_nodes - start->nodes;
+	usage->peak_paths = mem_stats.peak_paths - start->paths;
+	usage->peak_bytes = mem_stats.peak_bytes - start->bytes;
+	mem_stats.peak_nodes = max_long(mem_stats.peak_nodes, start->peak_nodes);
+	mem_stats.peak_paths = max_long(mem_stats.peak_paths, start->peak_paths);
+	mem_stats.peak_bytes = max_long(mem_stats.peak_bytes, start->peak_bytes);
+	return usage->nodes != 0 || usage->paths != 0 || usage->bytes != 0;
+}
+
+/* All nodes are allocated and freed here.
+ */
+static struct Expr *alloc_node(enum ExprTag tag) {
+	struct Expr *expr = malloc(sizeof(struct Expr));
+	expr->tag = tag;
+	MEM_COUNT(1, 0, sizeof(struct Expr));
+	return expr;
+}
+
+/* Free one node, but not its subexpressions.
+ */
+void free_node(struct Expr *expr) {
+	MEM_COUNT(-1, 0, -(long) sizeof(struct Expr));
+	free(expr);
+}
+
 /* Create new node for disjunction.
  */
 struct Expr *make_disj(struct Expr *expr1, struct Expr *expr2) {
-	struct Expr *expr = malloc(sizeof(struct Expr));
-	expr->tag = isDisj;
+	struct Expr *expr = alloc_node(isDisj);
 	expr->expr1 = expr1;
 	expr->expr2 = expr2;
+	fill_node(expr);
 	return expr;
 }
 
 struct Expr *make_conj(struct Expr *expr1, struct Expr *expr2) {
-	struct Expr *expr = malloc(sizeof(struct Expr));
-	expr->tag = isConj;
+	struct Expr *expr = alloc_node(isConj);
 	expr->expr1 = expr1;
 	expr->expr2 = expr2;
+	fill_node(expr);
 	return expr;
 }
 
 struct Expr *make_neg(struct Expr *expr1) {
-	struct Expr *expr = malloc(sizeof(struct Expr));
-	expr->tag = isNeg;
+	struct Expr *expr = alloc_node(isNeg);
 	expr->expr1 = expr1;
+	fill_node(expr);
 	return expr;
 }
 
 struct Expr *make_true() {
-	struct Expr *expr = malloc(sizeof(struct Expr));
-	expr->tag = isTrue;
+	struct Expr *expr = alloc_node(isTrue);
+	fill_node(expr);
 	return expr;
 }
 
 struct Expr *make_false() {
-	struct Expr *expr = malloc(sizeof(struct Expr));
-	expr->tag = isFalse;
+	struct Expr *expr = alloc_node(isFalse);
+	fill_node(expr);
 	return expr;
 }
 
-struct Expr *make_var(char var) {
-	struct Expr *expr = malloc(sizeof(struct Expr));
-	expr->tag = isVar;
+struct Expr *make_var(int var) {
+	struct Expr *expr = alloc_node(isVar);
 	expr->var = var;
+	fill_node(expr);
 	return expr;
 }
 
+/* Mix a 64-bit value into a hash (the finalizer of splitmix64).
+ */
+static unsigned long long mix_hash(unsigned long long h) {
+	h ^= h >> 30;
+	h *= 0xbf58476d1ce4e5b9ULL;
+	h ^= h >> 27;
+	h *= 0x94d049bb133111ebULL;
+	h ^= h >> 31;
+	return h;
+}
+
+/* Compute the cached fields of node from its tag, its variable and the
+ * cached fields of its subexpressions.
+ */
+void fill_node(struct Expr *expr) {
+	unsigned long long h = (unsigned long long) expr->tag + 1;
+	switch (expr->tag) {
+		case isDisj:
+		case isConj: {
+			struct Expr *expr1 = expr->expr1, *expr2 = expr->expr2;
+			expr->size = 1 + expr1->size + expr2->size;
+			expr->height = 1 + (expr1->height > expr2->height ? expr1->height : expr2->height);
+			expr->vars = expr1->vars | expr2->vars;
+			h = mix_hash(h * 31 + expr1->hash);
+			expr->hash = mix_hash(h * 31 + expr2->hash);
+			break;
+		}
+		case isNeg:
+			expr->size = 1 + expr->expr1->size;
+			expr->height = 1 + expr->expr1->height;
+			expr->vars = expr->expr1->vars;
+			expr->hash = mix_hash(h * 31 + expr->expr1->hash);
+			break;
+		case isVar:
+			expr->size = 1;
+			expr->height = 1;
+			expr->vars = VAR_BIT(expr->var);
+			expr->hash = mix_hash(h * 31 + (unsigned int) expr->var);
+			break;
+		default:
+			expr->size = 1;
+			expr->height = 1;
+			expr->vars = 0;
+			expr->hash = mix_hash(h);
+			break;
+	}
+}
+
+/*******************************************/
+/* Symbol table.                           */
+/*******************************************/
+
+/* Names of variables, numbered in order of interning. The names a to z
+ * are interned first, so that a single letter has number letter - 'a'.
+ * The table is shared by threads; it is only used when reading and
+ * printing, never in the search.
+ */
+static pthread_mutex_t symbols_lock = PTHREAD_MUTEX_INITIALIZER;
+static char **names = NULL;
+static int n_names = 0;
+static int cap_names = 0;
+static int *index_slots = NULL; // open addressing, -1 if empty
+static size_t cap_slots = 0;
+
+static unsigned long long hash_name(const char *name, size_t len) {
+	unsigned long long h = 0xcbf29ce484222325ULL;
+	for (size_t i = 0; i < len; i++) {
+		h ^= (unsigned char) name[i];
+		h *= 0x100000001b3ULL;
+	}
+	return h;
+}
+
+static size_t find_name(const char *name, size_t len) {
+	size_t i = hash_name(name, len) & (cap_slots - 1);
+	while (index_slots[i] != -1) {
+		char *other = names[index_slots[i]];
+		if (strncmp(other, name, len) == 0 && other[len] == '\0')
+			break;
+		i = (i + 1) & (cap_slots - 1);
+	}
+	return i;
+}
+
+/* Add name, which is not yet in the table. Keep load factor under one half.
+ */
+static int add_name(const char *name, size_t len) {
+	if (2 * (size_t) (n_names + 1) > cap_slots) {
+		cap_slots = cap_slots == 0 ? 256 : 2 * cap_slots;
+		free(index_slots);
+		index_slots = malloc(cap_slots * sizeof(int));
+		for (size_t i = 0; i < cap_slots; i++)
+			index_slots[i] = -1;
+		for (int var = 0; var < n_names; var++)
+			index_slots[find_name(names[var], strlen(names[var]))] = var;
+	}
+	if (n_names == cap_names) {
+		cap_names = cap_names == 0 ? 256 : 2 * cap_names;
+		names = realloc(names, cap_names * sizeof(char *));
+	}
+	names[n_names] = strndup(name, len);
+	index_slots[find_name(name, len)] = n_names;
+	return n_names++;
+}
+
+static void init_symbols() {
+	if (n_names > 0)
+		return;
+	for (char c = 'a'; c <= 'z'; c++)
+		add_name(&c, 1);
+}
+
+/* Number of name of given length, which is added if it is new.
+ */
+int intern_symbol(const char *name, size_t len) {
+	pthread_mutex_lock(&symbols_lock);
+	init_symbols();
+	size_t i = find_name(name, len);
+	int var = index_slots[i] != -1 ? index_slots[i] : add_name(name, len);
+	pthread_mutex_unlock(&symbols_lock);
+	return var;
+}
+
+/* Name of symbol. Numbers that have not been interned are printed as #
+ * followed by the number, which the parser does not read as a name.
+ */
+const char *symbol_name(int var) {
+	static __thread char unnamed[16];
+	pthread_mutex_lock(&symbols_lock);
+	init_symbols();
+	const char *name = var < n_names ? names[var] : NULL;
+	pthread_mutex_unlock(&symbols_lock);
+	if (name == NULL) {
+		snprintf(unnamed, sizeof(unnamed), "#%d", var);
+		name = unnamed;
+	}
+	return name;
+}
+
+int n_symbols() {
+	pthread_mutex_lock(&symbols_lock);
+	init_symbols();
+	int n = n_names;
+	pthread_mutex_unlock(&symbols_lock);
+	return n;
+}
+
 /* Make deep copy of expression.
  */
 struct Expr *copy_expr(struct Expr *expr) {
@@ -83,13 +295,17 @@ void free_expr(struct Expr *expr) {
 		default:
 			break;
 	}
-	free(expr);
+	free_node(expr);
 }
 
-/* Equality of two expressions.
+/* Equality of two expressions. Expressions that differ in their cached
+ * fields are told apart without looking below them.
  */
 bool equal_expr(struct Expr *expr1, struct Expr *expr2) {
-	if (expr1->tag != expr2->tag)
+	if (expr1 == expr2)
+		return true;
+	if (expr1->tag != expr2->tag || expr1->hash != expr2->hash ||
+			expr1->size != expr2->size || expr1->vars != expr2->vars)
 		return false;
 	else {
 		switch (expr1->tag) {
@@ -109,6 +325,121 @@ bool equal_expr(struct Expr *expr1, struct Expr *expr2) {
 	}
 }
 
+/* Number of nodes in expression.
+ */
+int size_expr(struct Expr *expr) {
+	return expr->size;
+}
+
+/* Structural hash of expression. Equal expressions have equal hashes.
+ */
+unsigned long long hash_expr(struct Expr *expr) {
+	return expr->hash;
+}
+
+/* Rename variables in order of first occurrence (from left to right)
+ * to a, b, c, ... (the symbols 0, 1, 2, ...), and after z to #26, #27,
+ * ... (see late_vars). Expressions that are the same up to renaming of
+ * variables are then equal. 'renamed' maps old to new symbols plus one,
+ * 0 if not yet seen.
+ */
+static int max_var(struct Expr *expr) {
+	switch (expr->tag) {
+		case isDisj:
+		case isConj: {
+			int max1 = max_var(expr->expr1);
+			int max2 = max_var(expr->expr2);
+			return max1 > max2 ? max1 : max2;
+		}
+		case isNeg:
+			return max_var(expr->expr1);
+		case isVar:
+			return expr->var;
+		default:
+			return -1;
+	}
+}
+
+static void normalize_vars_with(struct Expr *expr, int *renamed, int *next) {
+	switch (expr->tag) {
+		case isDisj:
+		case isConj:
+			normalize_vars_with(expr->expr1, renamed, next);
+			normalize_vars_with(expr->expr2, renamed, next);
+			break;
+		case isNeg:
+			normalize_vars_with(expr->expr1, renamed, next);
+			break;
+		case isVar:
+			if (renamed[expr->var] == 0)
+				renamed[expr->var] = ++(*next);
+			expr->var = renamed[expr->var] - 1;
+			break;
+		default:
+			break;
+	}
+	fill_node(expr);
+}
+
+/* Numbers of the symbols #26, #27, ..., which stand for the variables
+ * after z. They are interned, so that they cannot be taken by names that
+ * are read later, and are printed as a name that cannot be read back.
+ */
+static int *late_vars = NULL;
+static int n_late_vars = 0;
+
+static void rename_late_vars(struct Expr *expr, const int *late) {
+	switch (expr->tag) {
+		case isDisj:
+		case isConj:
+			rename_late_vars(expr->expr1, late);
+			rename_late_vars(expr->expr2, late);
+			break;
+		case isNeg:
+			rename_late_vars(expr->expr1, late);
+			break;
+		case isVar:
+			if (expr->var >= 26)
+				expr->var = late[expr->var - 26];
+			break;
+		default:
+			break;
+	}
+	fill_node(expr);
+}
+
+void normalize_vars(struct Expr *expr) {
+	int n = max_var(expr) + 1;
+	int small[64] = {0};
+	int *renamed = n <= 64 ? small : calloc(n, sizeof(int));
+	int next = 0;
+	normalize_vars_with(expr, renamed, &next);
+	if (next <= 26) {
+		if (renamed != small)
+			free(renamed);
+		return;
+	}
+	int *late = next - 26 <= n ? renamed : malloc((next - 26) * sizeof(int));
+	pthread_mutex_lock(&symbols_lock);
+	init_symbols();
+	if (next - 26 > n_late_vars) {
+		late_vars = realloc(late_vars, (next - 26) * sizeof(int));
+		for (; n_late_vars < next - 26; n_late_vars++) {
+			char name[16];
+			int len = snprintf(name, sizeof(name), "#%d", n_late_vars + 26);
+			size_t slot = find_name(name, len);
+			late_vars[n_late_vars] = index_slots[slot] != -1 ? index_slots[slot] : add_name(name, len);
+		}
+	}
+	memcpy(late, late_vars, (next - 26) * sizeof(int));
+	pthread_mutex_unlock(&symbols_lock);
+	rename_late_vars(expr, late);
+	if (late != renamed)
+		free(late);
+	if (renamed != small)
+		free(renamed);
+}
+
 /* Auxiliary functions for printing Boolean expressions.
  */
 static void print_expr_nested(struct Expr *expr, bool in_conj);
@@ -141,7 +472,7 @@ static void print_expr_nested(struct Expr *expr, bool in_conj) {
 			printf("F");
 			break;
 		case isVar:
-			printf("%c", expr->var);
+			printf("%s", symbol_name(expr->var));
 			break;
 	}
 }
@@ -184,14 +515,27 @@ static struct Expr *read_conj_from(char *str, int *pos);
 static struct Expr *read_base_from(char *str, int *pos);
 static bool force_read(char *str, int *pos, char c);
 
+/* Names of variables are letters, digits and underscores, not starting
+ * with a digit, other than T and F.
+ */
+static bool is_name_start(char c) {
+	return ('a' <= c && c <= 'z') || ('A' <= c && c <= 'Z') || c == '_';
+}
+
+static bool is_name_char(char c) {
+	return is_name_start(c) || ('0' <= c && c <= '9');
+}
+
 /* Read expression from string.
- * Return NULL if this fails.
+ * Return NULL if this fails. Parts read before the failure are freed
+ * by the function that finds it.
  */
 struct Expr *read_expr(char *str) {
 	int pos = 0;
 	struct Expr *expr = read_expr_from(str, &pos);
-	if (str[pos] != '\0') {
+	if (expr != NULL && str[pos] != '\0') {
 		fprintf(stderr, "Unexpected %c at %d in %s\n", str[pos], pos, str);
+		free_expr(expr);
 		return NULL;
 	}
 	return expr;
@@ -206,8 +550,10 @@ static struct Expr *read_expr_from(char *str, int *pos) {
 	while (str[*pos] == '|') {
 		(*pos)++;
 		struct Expr *next = read_conj_from(str, pos);
-		if (next == NULL)
+		if (next == NULL) {
+			free_expr(expr);
 			return NULL;
+		}
 		expr = make_disj(expr, next);
 	}
 	return expr;
@@ -220,8 +566,10 @@ static struct Expr *read_conj_from(char *str, int *pos) {
 	while (str[*pos] == '&') {
 		(*pos)++;
 		struct Expr *next = read_base_from(str, pos);
-		if (next == NULL)
+		if (next == NULL) {
+			free_expr(expr);
 			return NULL;
+		}
 		expr = make_conj(expr, next);
 	}
 	return expr;
@@ -231,12 +579,24 @@ static struct Expr *read_conj_from(char *str, int *pos) {
  */
 static struct Expr *read_base_from(char *str, int *pos) {
 	struct Expr *expr = NULL;
+	// T and F are constants, unless they start a longer name
+	bool constant = (str[*pos] == 'T' || str[*pos] == 'F') && !is_name_char(str[*pos + 1]);
+	if (is_name_start(str[*pos]) && !constant) {
+		int start = *pos;
+		while (is_name_char(str[*pos]))
+			(*pos)++;
+		return make_var(intern_symbol(str + start, *pos - start));
+	}
 	switch (str[*pos]) {
 		case '(':
 			(*pos)++;
 			expr = read_expr_from(str, pos);
-			if (expr == NULL || !force_read(str, pos, ')'))
+			if (expr == NULL)
+				return NULL;
+			if (!force_read(str, pos, ')')) {
+				free_expr(expr);
 				return NULL;
+			}
 			break;
 		case '-':
 			(*pos)++;
@@ -254,13 +614,7 @@ static struct Expr *read_base_from(char *str, int *pos) {
 			expr = make_true();
 			break;
 		default:
-			if ('a' <= str[*pos] && str[*pos] <= 'z') {
-				char var = str[*pos];
-				(*pos)++;
-				expr = make_var(var);
-			} else {
-				fprintf(stderr, "Unexpected %c at %d in %s\n", str[*pos], *pos, str);
-			}
+			fprintf(stderr, "Unexpected %c at %d in %s\n", str[*pos], *pos, str);
 			break;
 	}
 	return expr;
@@ -2,6 +2,7 @@
 #define LOGIC_H
 
 #include <stdbool.h>
+#include <stddef.h>
 
 /* The different kinds of expression.
  */
@@ -11,32 +12,80 @@ enum ExprTag {isDisj, isConj, isNeg, isTrue, isFalse, isVar};
  * If it is a disjunction or conjunction, it has two subexpressions
  * expr1 and expr2.
  * If it is a negation, it has one subexpression expr1.
- * If it is a variable, then it has a name var.
+ * If it is a variable, then it has a symbol var, which is the number
+ * of its name in the symbol table (see intern_symbol).
+ * Each node also caches some facts about the expression it is the root
+ * of, which the make_ functions compute from its subexpressions. Code
+ * that changes a node must call fill_node on it, and then on each node
+ * above it, or replace those by new nodes.
  */
 struct Expr {
 	enum ExprTag tag;
+	int size;                // number of nodes, as size_expr
+	int height;              // nodes on the longest path down, 1 for a leaf
+	unsigned vars;           // VAR_BIT of each variable in it
+	unsigned long long hash; // as hash_expr
 	union {
 		struct {
 			struct Expr *expr1;
 			struct Expr *expr2;
 		};
-		char var;
+		int var;
 	};
 };
 
+/* Bit of variable var in the vars of expressions. Variables a to z have
+ * bits of their own, others share them.
+ */
+#define VAR_BIT(var) (1u << (unsigned) (var) % 26)
+
+/* Accounting of the memory held in expressions and paths, per thread.
+ * It is switched on by setting mem_accounting, which should only be
+ * changed when no expressions or paths are live.
+ */
+struct MemStats {
+	long nodes;
+	long paths;
+	long bytes;
+	long peak_nodes;
+	long peak_paths;
+	long peak_bytes;
+};
+
+extern bool mem_accounting;
+extern __thread struct MemStats mem_stats;
+
+#define MEM_COUNT(nodes, paths, bytes) do { if (mem_accounting) mem_add(nodes, paths, bytes); } while (0)
+
+void mem_add(long nodes, long paths, long bytes);
+void mem_query_begin(struct MemStats *start);
+bool mem_query_end(struct MemStats *start, struct MemStats *usage);
+
 struct Expr *make_disj(struct Expr *expr1, struct Expr *expr2);
 struct Expr *make_conj(struct Expr *expr1, struct Expr *expr2);
 struct Expr *make_neg(struct Expr *expr);
 struct Expr *make_true();
 struct Expr *make_false();
-struct Expr *make_var(char name);
+struct Expr *make_var(int var);
+void fill_node(struct Expr *expr);
+
+int intern_symbol(const char *name, size_t len);
+const char *symbol_name(int var);
+int n_symbols();
 
 struct Expr *copy_expr(struct Expr *expr);
 
 void free_expr(struct Expr *expr);
+void free_node(struct Expr *expr);
 
 bool equal_expr(struct Expr *expr1, struct Expr *expr2);
 
+int size_expr(struct Expr *expr);
+
+unsigned long long hash_expr(struct Expr *expr);
+
+void normalize_vars(struct Expr *expr);
+
 void print_expr(struct Expr *expr);
 
 struct Expr *read_expr(char *str);
@@ -0,0 +1,72 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+/* Small client for logicd.
+ * Usage: logic_client socket <law set> [depth] < expressions
+ *        logic_client socket stats
+ * Sends the expressions, one per line, as a single request, and prints
+ * the answers of the server as they arrive.
+ */
+int main(int argc, char **argv) {
+	if (argc < 3 || argc > 4) {
+		fprintf(stderr, "Usage: %s socket (<law set> [depth] | stats)\n", argv[0]);
+		return 2;
+	}
+	struct sockaddr_un addr;
+	memset(&addr, 0, sizeof(addr));
+	addr.sun_family = AF_UNIX;
+	strncpy(addr.sun_path, argv[1], sizeof(addr.sun_path) - 1);
+	int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+	if (fd < 0 || connect(fd, (struct sockaddr *) &addr, sizeof(addr)) < 0) {
+		perror(argv[1]);
+		return 1;
+	}
+	FILE *out = fdopen(dup(fd), "w");
+	FILE *in = fdopen(fd, "r");
+	char *end = "end";
+	if (strcmp(argv[2], "stats") == 0) {
+		fprintf(out, "stats\n");
+	} else {
+		// collect lines first, as the request starts with their number
+		char **lines = NULL;
+		int n = 0;
+		char *line = NULL;
+		size_t len = 0;
+		while (getline(&line, &len, stdin) != -1) {
+			lines = realloc(lines, (n + 1) * sizeof(char *));
+			lines[n++] = strdup(line);
+		}
+		fprintf(out, "solve %s %s %d\n", argv[2], argc == 4 ? argv[3] : "0", n);
+		for (int i = 0; i < n; i++) {
+			fputs(lines[i], out);
+			if (lines[i][strlen(lines[i]) - 1] != '\n')
+				fputc('\n', out);
+			free(lines[i]);
+		}
+		free(lines);
+		free(line);
+		end = "done";
+	}
+	fprintf(out, "quit\n");
+	fclose(out);
+
+	char *line = NULL;
+	size_t len = 0;
+	int status = 1;
+	while (getline(&line, &len, in) != -1) {
+		fputs(line, stdout);
+		if (strncmp(line, end, strlen(end)) == 0) {
+			status = 0;
+			break;
+		}
+		if (strncmp(line, "error", 5) == 0)
+			break;
+	}
+	free(line);
+	fclose(in);
+	return status;
+}
@@ -0,0 +1,80 @@
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "logic.h"
+#include "server.h"
+#include "simplify.h"
+#include "trace.h"
+
+/* Run server on Unix domain socket.
+ * Usage: logicd [-w workers] [-c cache entries] [-H tt slots] [-s max states]
+ *               [-m max bytes] [-t max millis] [-I] [-M] [-T trace prefix] socket
+ * The limits are per expression, as for main1 and others. As there, they
+ * and the sizes of -c and -H may end in k, m or g. With -T, the
+ * searches of all workers are traced, and the trace is written to
+ * prefix.json and prefix.folded when the server stops. With -M, memory
+ * is counted and reported by the stats request. With -I, the searches
+ * rewrite expressions in place (see run_options.in_place).
+ */
+int main(int argc, char **argv) {
+	int n_workers = sysconf(_SC_NPROCESSORS_ONLN);
+	long cache_capacity = 1 << 20;
+	long tt_slots = 1 << 22;
+	struct Budget budget = {0, 0, 0};
+	char *trace_prefix = NULL;
+	bool ok = true;
+	int opt;
+	while (ok && (opt = getopt(argc, argv, "w:c:H:s:m:t:IMT:")) != -1) {
+		switch (opt) {
+			case 'w':
+				n_workers = atoi(optarg);
+				break;
+			case 'c':
+				ok = parse_size(optarg, &cache_capacity);
+				break;
+			case 'H':
+				ok = parse_size(optarg, &tt_slots);
+				break;
+			case 's':
+				ok = parse_size(optarg, &budget.max_states);
+				break;
+			case 'm':
+				ok = parse_size(optarg, &budget.max_bytes);
+				break;
+			case 't':
+				ok = parse_size(optarg, &budget.max_millis);
+				break;
+			case 'I':
+				run_options.in_place = true;
+				break;
+			case 'M':
+				mem_accounting = true;
+				break;
+			case 'T':
+				trace_prefix = optarg;
+				break;
+			default:
+				ok = false;
+				break;
+		}
+	}
+	if (!ok || optind != argc - 1 || n_workers < 1 || cache_capacity < 1 || tt_slots < 0) {
+		fprintf(stderr, "Usage: %s [-w workers] [-c cache entries] [-H tt slots] [-s max states] "
+				"[-m max bytes] [-t max millis] [-I] [-M] [-T trace prefix] socket\n", argv[0]);
+		return 2;
+	}
+	if (trace_prefix != NULL)
+		trace_enable(1 << 20);
+	int status = serve(argv[optind], n_workers, cache_capacity, tt_slots, &budget);
+	if (trace_prefix != NULL) {
+		char file_name[strlen(trace_prefix) + 8];
+		sprintf(file_name, "%s.json", trace_prefix);
+		trace_export_chrome(file_name);
+		sprintf(file_name, "%s.folded", trace_prefix);
+		trace_export_folded(file_name);
+	}
+	return status;
+}
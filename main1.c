@@ -1,8 +1,16 @@
 #include "simplify.h"
 
-int main(void) {
+/* For options, see parse_options.
+ */
+int main(int argc, char **argv) {
 	int max_depth = 6;
-	find_derivations_for_strings(max_depth,
-			law_searches, law_applies, law_names, n_laws());
+	if (!parse_options(argc, argv))
+		return 2;
+	if (run_options.binary)
+		find_derivations_for_binary(max_depth,
+				law_searches, law_applies, n_laws());
+	else
+		find_derivations_for_strings(max_depth,
+				law_searches, law_applies, law_names, n_laws());
 	return 0;
 }
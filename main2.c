@@ -1,7 +1,15 @@
 #include "simplify.h"
 
-int main(void) {
+/* For options, see parse_options.
+ */
+int main(int argc, char **argv) {
 	int max_depth = 6;
-	find_derivations_for_strings(max_depth,
-			extra_law_searches, extra_law_applies, extra_law_names, n_extra_laws());
+	if (!parse_options(argc, argv))
+		return 2;
+	if (run_options.binary)
+		find_derivations_for_binary(max_depth,
+				extra_law_searches, extra_law_applies, n_extra_laws());
+	else
+		find_derivations_for_strings(max_depth,
+				extra_law_searches, extra_law_applies, extra_law_names, n_extra_laws());
 }
@@ -0,0 +1,19 @@
+#include <stdio.h>
+
+#include "simplify.h"
+
+/* Find derivations with the laws of Part 1, 2 and 3 at once, as main1,
+ * main2 and main3 do, and print the three results on one line.
+ * For options, see parse_options; binary streams are not supported.
+ */
+int main(int argc, char **argv) {
+	if (!parse_options(argc, argv))
+		return 2;
+	if (run_options.binary) {
+		fprintf(stderr, "%s: binary streams are not supported\n", argv[0]);
+		return 2;
+	}
+	struct LawSet *sets[] = {find_law_set("basic"), find_law_set("extra"), find_law_set("cnf")};
+	find_nested_derivations_for_strings(sets, 3);
+	return 0;
+}
@@ -0,0 +1,92 @@
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "laws.h"
+#include "logic.h"
+#include "simplify.h"
+#include "table.h"
+#include "tt.h"
+
+/* Make the table of results of all expressions of up to max nodes nodes
+ * (see table.h), for all law sets at their max depths.
+ * Usage: make_table [-n max nodes] [-w workers] file
+ * Each expression is searched for as by main_all, which gives the same
+ * results as apply. The workers share a transposition table.
+ */
+
+struct Generator {
+	int max_nodes;
+	long n_entries;
+	int n_sets;
+	struct LawSet *sets[MAX_TABLE_SETS];
+	unsigned char *results;
+	struct TransTable *tt;
+	_Atomic long next; // rank of the next expression to search
+};
+
+static void *generate(void *arg) {
+	struct Generator *generator = arg;
+	struct NestedSearch nested;
+	init_nested_search(&nested, generator->sets, generator->n_sets);
+	nested.search.tt = generator->tt;
+	long rank;
+	while ((rank = atomic_fetch_add(&generator->next, 1)) < generator->n_entries) {
+		struct Expr *expr = table_unrank(rank, generator->max_nodes);
+		search_nested_derivations(&nested, expr, (1u << generator->n_sets) - 1);
+		for (int k = 0; k < generator->n_sets; k++)
+			generator->results[rank * generator->n_sets + k] =
+				nested.bests[k] == -1 ? 0xff : nested.bests[k];
+		free_expr(expr);
+	}
+	return NULL;
+}
+
+int main(int argc, char **argv) {
+	int max_nodes = 6;
+	int n_workers = sysconf(_SC_NPROCESSORS_ONLN);
+	int opt;
+	while ((opt = getopt(argc, argv, "n:w:")) != -1) {
+		switch (opt) {
+			case 'n':
+				max_nodes = atoi(optarg);
+				break;
+			case 'w':
+				n_workers = atoi(optarg);
+				break;
+			default:
+				optind = argc + 1;
+				break;
+		}
+	}
+	if (optind != argc - 1 || max_nodes < 1 || max_nodes > MAX_TABLE_NODES || n_workers < 1) {
+		fprintf(stderr, "Usage: %s [-n max nodes] [-w workers] file\n", argv[0]);
+		return 2;
+	}
+	struct Generator generator;
+	generator.max_nodes = max_nodes;
+	generator.n_entries = table_size(max_nodes);
+	generator.n_sets = n_law_sets();
+	for (int k = 0; k < generator.n_sets; k++)
+		generator.sets[k] = &law_sets[k];
+	generator.results = malloc(generator.n_entries * generator.n_sets);
+	generator.tt = tt_new(1 << 22);
+	atomic_init(&generator.next, 0);
+	pthread_t workers[n_workers];
+	for (int i = 0; i < n_workers; i++)
+		pthread_create(&workers[i], NULL, generate, &generator);
+	for (int i = 0; i < n_workers; i++)
+		pthread_join(workers[i], NULL);
+	bool ok = table_write(argv[optind], max_nodes, generator.sets, generator.n_sets,
+			generator.results);
+	if (ok)
+		printf("%ld expressions\n", generator.n_entries);
+	else
+		fprintf(stderr, "Cannot write %s\n", argv[optind]);
+	tt_free(generator.tt);
+	free(generator.results);
+	return ok ? 0 : 1;
+}
@@ -0,0 +1,106 @@
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "laws.h"
+#include "logic.h"
+#include "proof.h"
+
+/* Read path like "2 1 0" into path, which has room for it.
+ * Return whether it is a path.
+ */
+static bool read_path(char *str, int *path) {
+	int i = 0;
+	while (true) {
+		char *end;
+		long step = strtol(str, &end, 10);
+		if (end == str || step < 0 || step > 2)
+			return false;
+		path[i++] = step;
+		str = end;
+		if (step == 0)
+			break;
+	}
+	while (*str == ' ')
+		str++;
+	return *str == '\0';
+}
+
+/* Do step in place on the expression at *root, if it is right.
+ * Return why not if it is not, else NULL.
+ */
+static char *do_step(struct LawSet *set, struct UndoLog *log, struct Expr **root, char *step) {
+	char *at = NULL;
+	for (char *next = strstr(step, " at "); next != NULL; next = strstr(next + 1, " at "))
+		at = next;
+	if (at == NULL)
+		return "no \" at \"";
+	*at = '\0';
+	int law = 0;
+	while (law < set->n_laws && strcmp(set->names[law], step) != 0)
+		law++;
+	if (law == set->n_laws)
+		return "unknown law";
+	int path[strlen(at + 4) + 1];
+	if (!read_path(at + 4, path))
+		return "bad path";
+	struct Expr *expr = subexpr_at(*root, path);
+	if (expr == NULL)
+		return "no subexpression at path";
+	struct LawInfo *info = law_info(set->searches[law]);
+	if (!law_matches(info, expr))
+		return "law does not apply at path";
+	rewrite_at(log, root, path, info->rewrite);
+	return NULL;
+}
+
+/* Read the next line into reader->line, without its newline.
+ * Return its length, or -1 at the end of the input.
+ */
+static int read_line(struct ProofReader *reader) {
+	if (getline(&reader->line, &reader->len, reader->in) == -1)
+		return -1;
+	int size = strlen(reader->line);
+	if (size >= 1 && reader->line[size - 1] == '\n')
+		reader->line[--size] = '\0';
+	return size;
+}
+
+/* Check the next proof of reader. Return false if there is none.
+ */
+bool next_proof(struct ProofReader *reader, struct ProofResult *result) {
+	int size;
+	while ((size = read_line(reader)) == 0)
+		;
+	if (size == -1)
+		return false;
+	memset(result, 0, sizeof(struct ProofResult));
+	struct Expr *expr = read_expr(reader->line); // errors are reported by read_expr
+	struct Expr *root = expr;
+	if (expr == NULL)
+		result->kind = PROOF_ERROR;
+	while ((size = read_line(reader)) > 0) {
+		if (result->kind != PROOF_OK)
+			continue;
+		result->n_steps++;
+		result->reason = do_step(reader->set, &reader->log, &root, reader->line);
+		if (result->reason != NULL)
+			result->kind = PROOF_BAD_STEP;
+	}
+	if (expr != NULL) {
+		if (result->kind == PROOF_OK && root->tag != isTrue) {
+			result->kind = PROOF_BAD_END;
+			result->end = copy_expr(root);
+		}
+		while (reader->log.n_undos > 0)
+			undo_rewrite(&reader->log);
+		free_expr(expr);
+	}
+	return true;
+}
+
+void free_proof_reader(struct ProofReader *reader) {
+	free_undo_log(&reader->log);
+	free(reader->line);
+}
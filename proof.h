@@ -0,0 +1,51 @@
+#ifndef PROOF_H
+#define PROOF_H
+
+#include <stdbool.h>
+#include <stdio.h>
+
+#include "laws.h"
+#include "logic.h"
+
+/* Checking of derivations, without searching.
+ * The input is a number of proofs. A proof is a line with an expression,
+ * then a line per step of the form
+ *   <law name> at <path>
+ * with the name of a law of the law set and a path as printed by
+ * print_path, e.g. "2 1 0", then an empty line or the end of the input.
+ * A law name may itself contain " at "; the path follows the last one.
+ * A step is right if its law applies where its search would find it at
+ * path (see law_matches), and the proof is right if its steps are and
+ * the last one gives T.
+ *
+ * The steps are done in place on one expression, so each one takes time
+ * in the length of its path and the size of what it rewrites. All laws
+ * of the law set must have infos (see law_info).
+ */
+
+struct ProofReader {
+	struct LawSet *set;
+	FILE *in;
+	char *line;
+	size_t len;
+	struct UndoLog log;
+};
+
+enum ProofKind {
+	PROOF_OK,       // n_steps steps, ending in T
+	PROOF_BAD_STEP, // step n_steps (from 1) is the first that is not right, for reason
+	PROOF_BAD_END,  // the n_steps steps end in end instead of T
+	PROOF_ERROR     // the expression cannot be read
+};
+
+struct ProofResult {
+	enum ProofKind kind;
+	int n_steps;
+	char *reason;     // a constant string
+	struct Expr *end; // with PROOF_BAD_END, to be freed by the caller, else NULL
+};
+
+bool next_proof(struct ProofReader *reader, struct ProofResult *result);
+void free_proof_reader(struct ProofReader *reader);
+
+#endif // PROOF_H
@@ -0,0 +1,251 @@
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "scan.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define HAVE_X86 1
+#endif
+
+/* Arrays are padded to a multiple of this, for the widest kernel.
+ */
+#define PAD 32
+
+static void grow(struct NodeArray *array, int n) {
+	if (n <= array->cap)
+		return;
+	int cap = array->cap == 0 ? 64 : array->cap;
+	while (cap < n)
+		cap *= 2;
+	array->tags = realloc(array->tags, cap);
+	array->tags1 = realloc(array->tags1, cap);
+	array->tags2 = realloc(array->tags2, cap);
+	array->nodes = realloc(array->nodes, cap * sizeof(struct Expr *));
+	array->parents = realloc(array->parents, cap * sizeof(int));
+	array->depths = realloc(array->depths, cap * sizeof(int));
+	array->cap = cap;
+}
+
+static void add_node(struct NodeArray *array, struct Expr *expr, int parent, int depth) {
+	grow(array, array->n + 1);
+	int i = array->n++;
+	array->nodes[i] = expr;
+	array->parents[i] = parent;
+	array->depths[i] = depth;
+	array->tags[i] = expr->tag;
+	switch (expr->tag) {
+		case isDisj:
+		case isConj:
+			array->tags1[i] = expr->expr1->tag;
+			array->tags2[i] = expr->expr2->tag;
+			add_node(array, expr->expr1, i, depth + 1);
+			add_node(array, expr->expr2, i, depth + 1);
+			break;
+		case isNeg:
+			array->tags1[i] = expr->expr1->tag;
+			array->tags2[i] = NO_TAG;
+			add_node(array, expr->expr1, i, depth + 1);
+			break;
+		default:
+			array->tags1[i] = NO_TAG;
+			array->tags2[i] = NO_TAG;
+			break;
+	}
+}
+
+/* Flatten expression into array, replacing what was in it.
+ */
+void flatten_expr(struct Expr *expr, struct NodeArray *array) {
+	array->n = 0;
+	add_node(array, expr, -1, 0);
+	int padded = (array->n + PAD - 1) / PAD * PAD;
+	grow(array, padded);
+	for (int i = array->n; i < padded; i++)
+		array->tags[i] = array->tags1[i] = array->tags2[i] = NO_TAG;
+}
+
+/*******************************************/
+/* Kernels.                                */
+/*******************************************/
+
+/* Each kernel sets bit i of the bitmap of each law if node i has
+ * the tags of the law. Bits past the last node may be set too.
+ */
+typedef void (*MatchKernel)(struct NodeArray *array, struct LawInfo **infos, int n_laws);
+
+static bool tag_matches(signed char pattern, unsigned char tag) {
+	return pattern == ANY_TAG || pattern == tag;
+}
+
+static void match_scalar(struct NodeArray *array, struct LawInfo **infos, int n_laws) {
+	int words = words_of(array->n);
+	for (int law = 0; law < n_laws; law++) {
+		signed char *tags = infos[law]->tags;
+		uint32_t *bitmap = array->bitmaps + law * words;
+		memset(bitmap, 0, words * sizeof(uint32_t));
+		for (int i = 0; i < array->n; i++)
+			if (tag_matches(tags[0], array->tags[i]) &&
+					tag_matches(tags[1], array->tags1[i]) &&
+					tag_matches(tags[2], array->tags2[i]))
+				bitmap[i / 32] |= 1u << (i % 32);
+	}
+}
+
+#ifdef HAVE_X86
+
+/* Compare 16 tags with the pattern; all ones if the pattern is ANY_TAG.
+ */
+__attribute__((target("sse2")))
+static __m128i match_16(__m128i tags, signed char pattern) {
+	if (pattern == ANY_TAG)
+		return _mm_set1_epi8(-1);
+	return _mm_cmpeq_epi8(tags, _mm_set1_epi8(pattern));
+}
+
+__attribute__((target("sse2")))
+static void match_sse2(struct NodeArray *array, struct LawInfo **infos, int n_laws) {
+	int words = words_of(array->n);
+	for (int w = 0; w < words; w++) {
+		__m128i tags[2][3];
+		for (int h = 0; h < 2; h++) {
+			int i = w * 32 + h * 16;
+			tags[h][0] = _mm_loadu_si128((__m128i *) (array->tags + i));
+			tags[h][1] = _mm_loadu_si128((__m128i *) (array->tags1 + i));
+			tags[h][2] = _mm_loadu_si128((__m128i *) (array->tags2 + i));
+		}
+		for (int law = 0; law < n_laws; law++) {
+			signed char *pattern = infos[law]->tags;
+			uint32_t bits = 0;
+			for (int h = 0; h < 2; h++) {
+				__m128i m = _mm_and_si128(match_16(tags[h][0], pattern[0]),
+						_mm_and_si128(match_16(tags[h][1], pattern[1]),
+							match_16(tags[h][2], pattern[2])));
+				bits |= (uint32_t) _mm_movemask_epi8(m) << (h * 16);
+			}
+			array->bitmaps[law * words + w] = bits;
+		}
+	}
+}
+
+__attribute__((target("avx2")))
+static __m256i match_32(__m256i tags, signed char pattern) {
+	if (pattern == ANY_TAG)
+		return _mm256_set1_epi8(-1);
+	return _mm256_cmpeq_epi8(tags, _mm256_set1_epi8(pattern));
+}
+
+__attribute__((target("avx2")))
+static void match_avx2(struct NodeArray *array, struct LawInfo **infos, int n_laws) {
+	int words = words_of(array->n);
+	for (int w = 0; w < words; w++) {
+		int i = w * 32;
+		__m256i tags0 = _mm256_loadu_si256((__m256i *) (array->tags + i));
+		__m256i tags1 = _mm256_loadu_si256((__m256i *) (array->tags1 + i));
+		__m256i tags2 = _mm256_loadu_si256((__m256i *) (array->tags2 + i));
+		for (int law = 0; law < n_laws; law++) {
+			signed char *pattern = infos[law]->tags;
+			__m256i m = _mm256_and_si256(match_32(tags0, pattern[0]),
+					_mm256_and_si256(match_32(tags1, pattern[1]), match_32(tags2, pattern[2])));
+			array->bitmaps[law * words + w] = (uint32_t) _mm256_movemask_epi8(m);
+		}
+	}
+}
+
+#endif
+
+static MatchKernel kernel = NULL;
+static char *kernel_name = NULL;
+static pthread_once_t kernel_once = PTHREAD_ONCE_INIT;
+
+/* Choose the widest kernel the CPU supports, once for all threads.
+ */
+static void choose_kernel() {
+	MatchKernel chosen = match_scalar;
+	char *name = "scalar";
+#ifdef HAVE_X86
+	char *forced = getenv("LOGIC_MATCH_KERNEL");
+	__builtin_cpu_init();
+	if (forced == NULL || strcmp(forced, "scalar") != 0) {
+		if (__builtin_cpu_supports("avx2") && (forced == NULL || strcmp(forced, "sse2") != 0)) {
+			chosen = match_avx2;
+			name = "avx2";
+		} else if (__builtin_cpu_supports("sse2")) {
+			chosen = match_sse2;
+			name = "sse2";
+		}
+	}
+#endif
+	kernel = chosen;
+	kernel_name = name;
+}
+
+/* Name of the kernel used by match_laws. It can be forced to "sse2" or
+ * "scalar" with the environment variable LOGIC_MATCH_KERNEL.
+ */
+char *match_kernel() {
+	pthread_once(&kernel_once, choose_kernel);
+	return kernel_name;
+}
+
+/* Set the bitmaps of the laws with infos to the nodes that have their
+ * tags. Nodes of laws with a check must still be checked, see next_match.
+ */
+void match_laws(struct NodeArray *array, struct LawInfo **infos, int n_laws) {
+	pthread_once(&kernel_once, choose_kernel);
+	int size = n_laws * words_of(array->n);
+	if (size > array->bitmap_cap) {
+		array->bitmaps = realloc(array->bitmaps, size * sizeof(uint32_t));
+		array->bitmap_cap = size;
+	}
+	kernel(array, infos, n_laws);
+}
+
+/* Index of first node from index 'from' where law applies, after
+ * match_laws, or -1 if there is none.
+ */
+int next_match(struct NodeArray *array, struct LawInfo *info, int law, int from) {
+	int words = words_of(array->n);
+	uint32_t *bitmap = array->bitmaps + law * words;
+	for (int w = from / 32; w < words; w++) {
+		uint32_t bits = bitmap[w];
+		if (w == from / 32)
+			bits &= ~0u << (from % 32);
+		while (bits != 0) {
+			int i = w * 32 + __builtin_ctz(bits);
+			if (i >= array->n)
+				return -1;
+			if (info->check == NULL || info->check(array->nodes[i]))
+				return i;
+			bits &= bits - 1;
+		}
+	}
+	return -1;
+}
+
+/* Path to node, as the law searches make it, to be freed with free_path.
+ */
+int *path_to(struct NodeArray *array, int index) {
+	int depth = array->depths[index];
+	int *path = malloc((depth + 1) * sizeof(int));
+	MEM_COUNT(0, 1, (depth + 1) * sizeof(int));
+	path[depth] = 0;
+	for (int i = index; array->parents[i] != -1; i = array->parents[i])
+		// the first child directly follows its parent
+		path[array->depths[i] - 1] = array->parents[i] == i - 1 ? 1 : 2;
+	return path;
+}
+
+void free_node_array(struct NodeArray *array) {
+	free(array->tags);
+	free(array->tags1);
+	free(array->tags2);
+	free(array->nodes);
+	free(array->parents);
+	free(array->depths);
+	free(array->bitmaps);
+	memset(array, 0, sizeof(struct NodeArray));
+}
@@ -0,0 +1,40 @@
+#ifndef SCAN_H
+#define SCAN_H
+
+#include <stdint.h>
+
+#include "laws.h"
+#include "logic.h"
+
+/* Nodes of an expression in prefix order, which is the order in which
+ * the law searches find them, with the tags of each node and its
+ * children in separate arrays, so that the tag patterns of laws
+ * (see struct LawInfo) can be matched against many nodes at once.
+ * A missing child has tag NO_TAG. The arrays are reused when an
+ * expression is flattened into them again.
+ */
+#define NO_TAG 0x7f
+
+struct NodeArray {
+	int n;
+	int cap;
+	unsigned char *tags;
+	unsigned char *tags1;
+	unsigned char *tags2;
+	struct Expr **nodes;
+	int *parents; // -1 for the root
+	int *depths;
+	uint32_t *bitmaps; // words_of(n) words per law, from match_laws
+	int bitmap_cap;
+};
+
+#define words_of(n) (((n) + 31) / 32)
+
+void flatten_expr(struct Expr *expr, struct NodeArray *array);
+void match_laws(struct NodeArray *array, struct LawInfo **infos, int n_laws);
+int next_match(struct NodeArray *array, struct LawInfo *info, int law, int from);
+int *path_to(struct NodeArray *array, int index);
+char *match_kernel();
+void free_node_array(struct NodeArray *array);
+
+#endif // SCAN_H
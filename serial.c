@@ -0,0 +1,816 @@
+#include <limits.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "logic.h"
+#include "serial.h"
+
+static const char MAGIC[] = "LEXB";
+
+/* Growable byte buffer for encoding.
+ */
+struct Bytes {
+	unsigned char *data;
+	size_t len;
+	size_t cap;
+};
+
+static void put_byte(struct Bytes *bytes, unsigned char b) {
+	if (bytes->len == bytes->cap) {
+		bytes->cap = bytes->cap == 0 ? 64 : 2 * bytes->cap;
+		bytes->data = realloc(bytes->data, bytes->cap);
+	}
+	bytes->data[bytes->len++] = b;
+}
+
+/* Unsigned LEB128: seven bits per byte, high bit set if more follow.
+ */
+static void put_varint(struct Bytes *bytes, unsigned long long n) {
+	while (n >= 0x80) {
+		put_byte(bytes, (unsigned char) (n | 0x80));
+		n >>= 7;
+	}
+	put_byte(bytes, (unsigned char) n);
+}
+
+/* Signed numbers are zigzag coded, so that -1 takes one byte.
+ */
+static void put_svarint(struct Bytes *bytes, long long n) {
+	put_varint(bytes, ((unsigned long long) n << 1) ^ (unsigned long long) (n >> 63));
+}
+
+/* Position in payload being decoded.
+ */
+struct Cursor {
+	const unsigned char *p;
+	const unsigned char *end;
+};
+
+static bool get_byte(struct Cursor *cur, int *b) {
+	if (cur->p == cur->end)
+		return false;
+	*b = *cur->p++;
+	return true;
+}
+
+static bool get_varint(struct Cursor *cur, unsigned long long *n) {
+	*n = 0;
+	for (int shift = 0; shift < 64; shift += 7) {
+		int b;
+		if (!get_byte(cur, &b))
+			return false;
+		*n |= (unsigned long long) (b & 0x7f) << shift;
+		if (b < 0x80)
+			return true;
+	}
+	return false;
+}
+
+static bool get_svarint(struct Cursor *cur, long long *n) {
+	unsigned long long u;
+	if (!get_varint(cur, &u))
+		return false;
+	*n = (long long) (u >> 1) ^ -(long long) (u & 1);
+	return true;
+}
+
+/*******************************************/
+/* Expressions as trees.                   */
+/*******************************************/
+
+/* Write nodes in prefix order.
+ */
+static void encode_tree(struct Expr *expr, struct Bytes *bytes) {
+	put_byte(bytes, (unsigned char) expr->tag);
+	switch (expr->tag) {
+		case isDisj:
+		case isConj:
+			encode_tree(expr->expr1, bytes);
+			encode_tree(expr->expr2, bytes);
+			break;
+		case isNeg:
+			encode_tree(expr->expr1, bytes);
+			break;
+		case isVar:
+			put_varint(bytes, (unsigned long long) expr->var);
+			break;
+		default:
+			break;
+	}
+}
+
+/* Symbols of a stream, which are numbered by the writer, mapped to
+ * the symbols of this process. Numbers of a to z need not be named.
+ */
+struct SymbolMap {
+	int *vars; // -1 if not named in the stream
+	size_t n;
+};
+
+/* Symbol of this process for number in stream, or -1 if it has none.
+ * Without map, the numbers are those of this process, which must have
+ * been interned.
+ */
+static long map_symbol(struct SymbolMap *map, unsigned long long var) {
+	if (map == NULL)
+		return var < (unsigned long long) n_symbols() ? (long) var : -1;
+	if (var < (unsigned long long) map->n && map->vars[var] != -1)
+		return map->vars[var];
+	return var < 26 ? (long) var : -1;
+}
+
+/* A disjunction, conjunction or negation of which the subexpressions
+ * are being read, with its first one once it is read.
+ */
+struct Pending {
+	int tag;
+	struct Expr *expr1;
+};
+
+/* Read nodes in prefix order. Return NULL if this fails.
+ * The nodes above the one being read are kept on a stack of their own,
+ * as the depth is set by the stream.
+ */
+static struct Expr *decode_tree(struct Cursor *cur, struct SymbolMap *map) {
+	struct Pending small[64];
+	struct Pending *stack = small;
+	size_t cap = sizeof(small) / sizeof(struct Pending);
+	size_t depth = 0;
+	struct Expr *expr = NULL;
+	int tag;
+	while (expr == NULL && get_byte(cur, &tag)) {
+		unsigned long long var;
+		long symbol;
+		switch (tag) {
+			case isDisj:
+			case isConj:
+			case isNeg:
+				if (depth + 1 >= SERIAL_MAX_HEIGHT)
+					break;
+				if (depth == cap) {
+					cap *= 2;
+					if (stack == small) {
+						stack = malloc(cap * sizeof(struct Pending));
+						memcpy(stack, small, sizeof(small));
+					} else {
+						stack = realloc(stack, cap * sizeof(struct Pending));
+					}
+				}
+				stack[depth].tag = tag;
+				stack[depth++].expr1 = NULL;
+				continue;
+			case isTrue:
+				expr = make_true();
+				break;
+			case isFalse:
+				expr = make_false();
+				break;
+			case isVar:
+				if (get_varint(cur, &var) && (symbol = map_symbol(map, var)) != -1)
+					expr = make_var((int) symbol);
+				break;
+			default:
+				break;
+		}
+		if (expr == NULL) // a bad node, or too high
+			break;
+		// complete the nodes above it that now have all their subexpressions
+		while (depth > 0) {
+			struct Pending *top = &stack[depth - 1];
+			if (top->tag == isNeg) {
+				expr = make_neg(expr);
+			} else if (top->expr1 == NULL) {
+				top->expr1 = expr;
+				expr = NULL;
+				break;
+			} else {
+				expr = top->tag == isDisj ? make_disj(top->expr1, expr) :
+					make_conj(top->expr1, expr);
+			}
+			depth--;
+		}
+	}
+	if (expr == NULL)
+		for (size_t i = 0; i < depth; i++)
+			if (stack[i].expr1 != NULL)
+				free_expr(stack[i].expr1);
+	if (stack != small)
+		free(stack);
+	return expr;
+}
+
+/* Encode expression as tree, without record header, such as for keys.
+ * Variables are numbered as in this process.
+ * The result is to be freed by the caller.
+ */
+unsigned char *serial_encode_expr(struct Expr *expr, size_t *len) {
+	struct Bytes bytes = {NULL, 0, 0};
+	encode_tree(expr, &bytes);
+	*len = bytes.len;
+	return bytes.data;
+}
+
+/* Decode expression encoded by serial_encode_expr.
+ * Return NULL if this fails.
+ */
+struct Expr *serial_decode_expr(const unsigned char *buf, size_t len) {
+	struct Cursor cur = {buf, buf + len};
+	struct Expr *expr = decode_tree(&cur, NULL);
+	if (expr != NULL && cur.p != cur.end) {
+		free_expr(expr);
+		return NULL;
+	}
+	return expr;
+}
+
+/*******************************************/
+/* Hash-consing for the DAG section.       */
+/*******************************************/
+
+/* A node is identified by its tag and the numbers of its children,
+ * or the number of its variable.
+ */
+struct DagEntry {
+	int tag;
+	long a;
+	long b;
+	long id;
+};
+
+struct DagTable {
+	struct DagEntry *entries;
+	size_t cap;
+	long count;
+};
+
+static size_t dag_slot(struct DagTable *table, int tag, long a, long b) {
+	unsigned long long h = (unsigned long long) tag * 0x9e3779b97f4a7c15ULL;
+	h = (h ^ (unsigned long long) a) * 0xbf58476d1ce4e5b9ULL;
+	h = (h ^ (unsigned long long) b) * 0x94d049bb133111ebULL;
+	size_t i = (size_t) (h ^ (h >> 32)) & (table->cap - 1);
+	while (table->entries[i].id != -1 &&
+			(table->entries[i].tag != tag || table->entries[i].a != a ||
+			 table->entries[i].b != b))
+		i = (i + 1) & (table->cap - 1);
+	return i;
+}
+
+static void dag_reset(struct DagTable *table) {
+	free(table->entries);
+	table->cap = 1024;
+	table->count = 0;
+	table->entries = malloc(table->cap * sizeof(struct DagEntry));
+	for (size_t i = 0; i < table->cap; i++)
+		table->entries[i].id = -1;
+}
+
+/* Keep load factor under one half.
+ */
+static void dag_grow(struct DagTable *table) {
+	struct DagEntry *old = table->entries;
+	size_t old_cap = table->cap;
+	table->cap *= 2;
+	table->entries = malloc(table->cap * sizeof(struct DagEntry));
+	for (size_t i = 0; i < table->cap; i++)
+		table->entries[i].id = -1;
+	for (size_t i = 0; i < old_cap; i++)
+		if (old[i].id != -1)
+			table->entries[dag_slot(table, old[i].tag, old[i].a, old[i].b)] = old[i];
+	free(old);
+}
+
+/* Number of node, which is added if it is new.
+ */
+static long dag_intern(struct DagTable *table, int tag, long a, long b, bool *is_new) {
+	if (2 * (size_t) (table->count + 1) > table->cap)
+		dag_grow(table);
+	size_t i = dag_slot(table, tag, a, b);
+	*is_new = table->entries[i].id == -1;
+	if (*is_new) {
+		table->entries[i].tag = tag;
+		table->entries[i].a = a;
+		table->entries[i].b = b;
+		table->entries[i].id = table->count++;
+	}
+	return table->entries[i].id;
+}
+
+/* Per node of an expression, in prefix order: its number, whether it is
+ * new in the section, and the size of its subexpression.
+ */
+struct DagScan {
+	long *ids;
+	bool *is_new;
+	long *sizes;
+	long n;
+	long cap;
+};
+
+static long dag_scan(struct DagTable *table, struct Expr *expr, struct DagScan *scan) {
+	if (scan->n == scan->cap) {
+		scan->cap = scan->cap == 0 ? 64 : 2 * scan->cap;
+		scan->ids = realloc(scan->ids, scan->cap * sizeof(long));
+		scan->is_new = realloc(scan->is_new, scan->cap * sizeof(bool));
+		scan->sizes = realloc(scan->sizes, scan->cap * sizeof(long));
+	}
+	long k = scan->n++;
+	long a = 0;
+	long b = 0;
+	switch (expr->tag) {
+		case isDisj:
+		case isConj:
+			a = dag_scan(table, expr->expr1, scan);
+			b = dag_scan(table, expr->expr2, scan);
+			break;
+		case isNeg:
+			a = dag_scan(table, expr->expr1, scan);
+			break;
+		case isVar:
+			a = expr->var;
+			break;
+		default:
+			break;
+	}
+	scan->ids[k] = dag_intern(table, expr->tag, a, b, &scan->is_new[k]);
+	scan->sizes[k] = scan->n - k;
+	return scan->ids[k];
+}
+
+/* Write new nodes in postfix order, and references for nodes defined before.
+ * This defines nodes in the same order as they were numbered by dag_scan.
+ */
+static void dag_emit(struct Expr *expr, struct DagScan *scan, long *k, struct Bytes *bytes) {
+	long i = (*k)++;
+	if (!scan->is_new[i]) {
+		put_byte(bytes, SERIAL_REF);
+		put_varint(bytes, (unsigned long long) scan->ids[i]);
+		*k += scan->sizes[i] - 1;
+		return;
+	}
+	switch (expr->tag) {
+		case isDisj:
+		case isConj:
+			dag_emit(expr->expr1, scan, k, bytes);
+			dag_emit(expr->expr2, scan, k, bytes);
+			put_byte(bytes, (unsigned char) expr->tag);
+			break;
+		case isNeg:
+			dag_emit(expr->expr1, scan, k, bytes);
+			put_byte(bytes, isNeg);
+			break;
+		case isVar:
+			put_byte(bytes, isVar);
+			put_varint(bytes, (unsigned long long) expr->var);
+			break;
+		default:
+			put_byte(bytes, (unsigned char) expr->tag);
+			break;
+	}
+}
+
+/*******************************************/
+/* Writing streams.                        */
+/*******************************************/
+
+struct SerialWriter {
+	FILE *out;
+	int flags;
+	struct Bytes payload;
+	struct Bytes header;
+	struct DagTable dag;
+	struct DagScan scan;
+	bool *named; // symbols named in the stream
+	size_t cap_named;
+	bool ok;
+};
+
+/* Start stream, writing header. With flag SERIAL_DAG, expressions are
+ * written to the DAG section, sharing equal subexpressions.
+ */
+struct SerialWriter *serial_writer_open(FILE *out, int flags) {
+	struct SerialWriter *writer = calloc(1, sizeof(struct SerialWriter));
+	writer->out = out;
+	writer->flags = flags;
+	writer->ok = true;
+	if (flags & SERIAL_DAG)
+		dag_reset(&writer->dag);
+	unsigned char header[6] = {'L', 'E', 'X', 'B', SERIAL_VERSION, (unsigned char) flags};
+	if (fwrite(header, 1, sizeof(header), out) != sizeof(header))
+		writer->ok = false;
+	return writer;
+}
+
+static bool write_record(struct SerialWriter *writer, char kind) {
+	writer->header.len = 0;
+	put_byte(&writer->header, (unsigned char) kind);
+	put_varint(&writer->header, writer->payload.len);
+	if (fwrite(writer->header.data, 1, writer->header.len, writer->out) != writer->header.len ||
+			fwrite(writer->payload.data, 1, writer->payload.len, writer->out) != writer->payload.len)
+		writer->ok = false;
+	return writer->ok;
+}
+
+/* Write 'N' records for the variables of expr that need to be named.
+ */
+static void name_vars(struct SerialWriter *writer, struct Expr *expr) {
+	switch (expr->tag) {
+		case isDisj:
+		case isConj:
+			name_vars(writer, expr->expr1);
+			name_vars(writer, expr->expr2);
+			break;
+		case isNeg:
+			name_vars(writer, expr->expr1);
+			break;
+		case isVar:
+			if (expr->var < 26)
+				break;
+			if ((size_t) expr->var >= writer->cap_named) {
+				size_t cap = writer->cap_named == 0 ? 256 : writer->cap_named;
+				while (cap <= (size_t) expr->var)
+					cap *= 2;
+				writer->named = realloc(writer->named, cap * sizeof(bool));
+				memset(writer->named + writer->cap_named, 0, (cap - writer->cap_named) * sizeof(bool));
+				writer->cap_named = cap;
+			}
+			if (!writer->named[expr->var]) {
+				const char *name = symbol_name(expr->var);
+				writer->payload.len = 0;
+				put_varint(&writer->payload, (unsigned long long) expr->var);
+				for (size_t i = 0; name[i] != '\0'; i++)
+					put_byte(&writer->payload, (unsigned char) name[i]);
+				write_record(writer, 'N');
+				writer->named[expr->var] = true;
+			}
+			break;
+		default:
+			break;
+	}
+}
+
+bool serial_write_expr(struct SerialWriter *writer, struct Expr *expr) {
+	name_vars(writer, expr);
+	writer->payload.len = 0;
+	if (!(writer->flags & SERIAL_DAG)) {
+		encode_tree(expr, &writer->payload);
+		return write_record(writer, 'E');
+	}
+	long k = 0;
+	writer->scan.n = 0;
+	dag_scan(&writer->dag, expr, &writer->scan);
+	dag_emit(expr, &writer->scan, &k, &writer->payload);
+	return write_record(writer, 'D');
+}
+
+bool serial_write_result(struct SerialWriter *writer, struct Result *result) {
+	writer->payload.len = 0;
+	put_svarint(&writer->payload, result->steps);
+	put_varint(&writer->payload, (unsigned long long) result->status);
+	put_varint(&writer->payload, (unsigned long long) result->n_proof);
+	for (int i = 0; i < result->n_proof; i++) {
+		int *path = result->proof[i].path;
+		int n = 0;
+		while (path[n] > 0)
+			n++;
+		put_varint(&writer->payload, (unsigned long long) result->proof[i].law);
+		put_varint(&writer->payload, (unsigned long long) n);
+		for (int j = 0; j < n; j++)
+			put_byte(&writer->payload, (unsigned char) path[j]);
+	}
+	return write_record(writer, 'R');
+}
+
+/* Forget shared subexpressions; later expressions are numbered from 0 again.
+ * This bounds the memory of long streams.
+ */
+void serial_new_section(struct SerialWriter *writer) {
+	if (!(writer->flags & SERIAL_DAG))
+		return;
+	dag_reset(&writer->dag);
+	writer->payload.len = 0;
+	write_record(writer, 'S');
+}
+
+/* Flush and free writer. Return false if any write failed.
+ */
+bool serial_writer_close(struct SerialWriter *writer) {
+	bool ok = writer->ok && fflush(writer->out) == 0;
+	free(writer->payload.data);
+	free(writer->header.data);
+	free(writer->dag.entries);
+	free(writer->scan.ids);
+	free(writer->scan.is_new);
+	free(writer->scan.sizes);
+	free(writer->named);
+	free(writer);
+	return ok;
+}
+
+/*******************************************/
+/* Reading streams.                        */
+/*******************************************/
+
+#define READ_CHUNK (1 << 16)
+
+struct SerialReader {
+	FILE *in; // NULL if reading from memory
+	const unsigned char *buf;
+	unsigned char *own_buf;
+	size_t len;
+	size_t pos;
+	size_t cap;
+	int flags;
+	// nodes of the DAG section, sharing subexpressions
+	struct Expr **nodes;
+	size_t n_nodes;
+	size_t cap_nodes;
+	struct Expr **stack;
+	size_t cap_stack;
+	struct SymbolMap symbols;
+};
+
+/* Make sure that at least 'need' unread bytes are in the buffer.
+ */
+static bool fill(struct SerialReader *reader, size_t need) {
+	if (reader->len - reader->pos >= need)
+		return true;
+	if (reader->in == NULL)
+		return false;
+	memmove(reader->own_buf, reader->own_buf + reader->pos, reader->len - reader->pos);
+	reader->len -= reader->pos;
+	reader->pos = 0;
+	if (need > reader->cap) {
+		reader->cap = need > 2 * reader->cap ? need : 2 * reader->cap;
+		reader->own_buf = realloc(reader->own_buf, reader->cap);
+	}
+	reader->buf = reader->own_buf;
+	while (reader->len < need) {
+		size_t got = fread(reader->own_buf + reader->len, 1, reader->cap - reader->len, reader->in);
+		if (got == 0)
+			return false;
+		reader->len += got;
+	}
+	return true;
+}
+
+static bool read_header(struct SerialReader *reader) {
+	if (!fill(reader, 6) || memcmp(reader->buf, MAGIC, 4) != 0) {
+		fprintf(stderr, "Not a LEXB stream\n");
+		return false;
+	}
+	if (reader->buf[4] != SERIAL_VERSION) {
+		fprintf(stderr, "Unsupported LEXB version %d\n", reader->buf[4]);
+		return false;
+	}
+	reader->flags = reader->buf[5];
+	reader->pos = 6;
+	return true;
+}
+
+/* Open stream. Return NULL if it does not start with a valid header.
+ */
+struct SerialReader *serial_reader_open(FILE *in) {
+	struct SerialReader *reader = calloc(1, sizeof(struct SerialReader));
+	reader->in = in;
+	reader->cap = READ_CHUNK;
+	reader->own_buf = malloc(reader->cap);
+	reader->buf = reader->own_buf;
+	if (!read_header(reader)) {
+		serial_reader_close(reader);
+		return NULL;
+	}
+	return reader;
+}
+
+/* Read stream from memory, such as a mapped file. The buffer is not copied.
+ */
+struct SerialReader *serial_reader_open_mem(const unsigned char *buf, size_t len) {
+	struct SerialReader *reader = calloc(1, sizeof(struct SerialReader));
+	reader->buf = buf;
+	reader->len = len;
+	if (!read_header(reader)) {
+		serial_reader_close(reader);
+		return NULL;
+	}
+	return reader;
+}
+
+/* The nodes of the DAG section are freed one by one,
+ * as they share subexpressions.
+ */
+static void clear_nodes(struct SerialReader *reader) {
+	for (size_t i = 0; i < reader->n_nodes; i++)
+		free_node(reader->nodes[i]);
+	reader->n_nodes = 0;
+}
+
+static struct Expr *make_node(int tag, struct Expr *expr1, struct Expr *expr2, int var) {
+	switch (tag) {
+		case isDisj:
+			return make_disj(expr1, expr2);
+		case isConj:
+			return make_conj(expr1, expr2);
+		case isNeg:
+			return make_neg(expr1);
+		case isTrue:
+			return make_true();
+		case isFalse:
+			return make_false();
+		default:
+			return make_var(var);
+	}
+}
+
+/* Run the nodes in postfix order on a stack. Return copy of the
+ * resulting expression, or NULL if this fails.
+ */
+static struct Expr *decode_dag(struct SerialReader *reader, struct Cursor *cur) {
+	size_t depth = 0;
+	int tag;
+	long symbol = 0;
+	while (get_byte(cur, &tag)) {
+		struct Expr *expr1 = NULL;
+		struct Expr *expr2 = NULL;
+		unsigned long long n = 0;
+		if (depth + 1 > reader->cap_stack) {
+			reader->cap_stack = reader->cap_stack == 0 ? 64 : 2 * reader->cap_stack;
+			reader->stack = realloc(reader->stack, reader->cap_stack * sizeof(struct Expr *));
+		}
+		if (tag == SERIAL_REF) {
+			if (!get_varint(cur, &n) || n >= reader->n_nodes)
+				return NULL;
+			reader->stack[depth++] = reader->nodes[n];
+			continue;
+		}
+		switch (tag) {
+			case isDisj:
+			case isConj:
+				if (depth < 2)
+					return NULL;
+				expr2 = reader->stack[--depth];
+				expr1 = reader->stack[--depth];
+				break;
+			case isNeg:
+				if (depth < 1)
+					return NULL;
+				expr1 = reader->stack[--depth];
+				break;
+			case isVar:
+				if (!get_varint(cur, &n) || (symbol = map_symbol(&reader->symbols, n)) == -1)
+					return NULL;
+				break;
+			case isTrue:
+			case isFalse:
+				break;
+			default:
+				return NULL;
+		}
+		if (reader->n_nodes == reader->cap_nodes) {
+			reader->cap_nodes = reader->cap_nodes == 0 ? 1024 : 2 * reader->cap_nodes;
+			reader->nodes = realloc(reader->nodes, reader->cap_nodes * sizeof(struct Expr *));
+		}
+		struct Expr *node = make_node(tag, expr1, expr2, (int) symbol);
+		reader->nodes[reader->n_nodes++] = node;
+		if (node->height > SERIAL_MAX_HEIGHT)
+			return NULL;
+		reader->stack[depth++] = node;
+	}
+	return depth == 1 ? copy_expr(reader->stack[0]) : NULL;
+}
+
+/* Read the name of a symbol of the stream.
+ */
+static bool decode_name(struct SerialReader *reader, struct Cursor *cur) {
+	unsigned long long var;
+	if (!get_varint(cur, &var) || var >= (1ULL << 31) || cur->p == cur->end)
+		return false;
+	struct SymbolMap *map = &reader->symbols;
+	if (var >= map->n) {
+		size_t n = map->n == 0 ? 256 : map->n;
+		while (n <= var)
+			n *= 2;
+		map->vars = realloc(map->vars, n * sizeof(int));
+		for (size_t i = map->n; i < n; i++)
+			map->vars[i] = -1;
+		map->n = n;
+	}
+	map->vars[var] = intern_symbol((const char *) cur->p, cur->end - cur->p);
+	cur->p = cur->end;
+	return true;
+}
+
+static bool decode_result(struct Cursor *cur, struct Result *result) {
+	long long steps;
+	unsigned long long status;
+	unsigned long long n_proof;
+	result->steps = -1;
+	result->status = resultExact;
+	result->n_proof = 0;
+	result->proof = NULL;
+	if (!get_svarint(cur, &steps) || !get_varint(cur, &status) || status > resultApproximate ||
+			!get_varint(cur, &n_proof) || n_proof > (size_t) (cur->end - cur->p))
+		return false;
+	result->steps = (int) steps;
+	result->status = (enum ResultStatus) status;
+	result->proof = calloc(n_proof, sizeof(struct ProofStep));
+	for (unsigned long long i = 0; i < n_proof; i++) {
+		unsigned long long law;
+		unsigned long long n;
+		if (!get_varint(cur, &law) || !get_varint(cur, &n) ||
+				n > (size_t) (cur->end - cur->p))
+			return false;
+		int *path = malloc((n + 1) * sizeof(int));
+		for (unsigned long long j = 0; j < n; j++) {
+			int b;
+			get_byte(cur, &b);
+			path[j] = b;
+		}
+		path[n] = 0;
+		result->proof[i].law = (int) law;
+		result->proof[i].path = path;
+		result->n_proof++;
+	}
+	return true;
+}
+
+/* Read next record. An expression is stored in *expr, to be freed by the
+ * caller; a result in *result, to be freed with free_result.
+ * Sections are handled internally.
+ */
+enum SerialKind serial_read(struct SerialReader *reader,
+		struct Expr **expr, struct Result *result) {
+	while (true) {
+		if (!fill(reader, 1))
+			return serialEnd;
+		int kind = reader->buf[reader->pos++];
+		unsigned long long len = 0;
+		for (int shift = 0; ; shift += 7) {
+			if (shift >= 64 || !fill(reader, 1)) {
+				fprintf(stderr, "Truncated LEXB record\n");
+				return serialError;
+			}
+			int b = reader->buf[reader->pos++];
+			len |= (unsigned long long) (b & 0x7f) << shift;
+			if (b < 0x80)
+				break;
+		}
+		if (!fill(reader, len)) {
+			fprintf(stderr, "Truncated LEXB record\n");
+			return serialError;
+		}
+		struct Cursor cur = {reader->buf + reader->pos, reader->buf + reader->pos + len};
+		reader->pos += len;
+		switch (kind) {
+			case 'E':
+				*expr = decode_tree(&cur, &reader->symbols);
+				if (*expr != NULL && cur.p != cur.end)
+					free_expr(*expr);
+				else if (*expr != NULL)
+					return serialExpr;
+				break;
+			case 'D':
+				*expr = decode_dag(reader, &cur);
+				if (*expr == NULL)
+					break;
+				return serialExpr;
+			case 'R':
+				if (!decode_result(&cur, result) || cur.p != cur.end) {
+					free_result(result);
+					break;
+				}
+				return serialResult;
+			case 'S':
+				clear_nodes(reader);
+				continue;
+			case 'N':
+				if (!decode_name(reader, &cur))
+					break;
+				continue;
+			default:
+				break;
+		}
+		fprintf(stderr, "Bad LEXB record of kind %d\n", kind);
+		return serialError;
+	}
+}
+
+void serial_reader_close(struct SerialReader *reader) {
+	clear_nodes(reader);
+	free(reader->nodes);
+	free(reader->stack);
+	free(reader->symbols.vars);
+	free(reader->own_buf);
+	free(reader);
+}
+
+/* Free proof in result.
+ */
+void free_result(struct Result *result) {
+	for (int i = 0; i < result->n_proof; i++)
+		free(result->proof[i].path);
+	free(result->proof);
+	result->proof = NULL;
+	result->n_proof = 0;
+}
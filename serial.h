@@ -0,0 +1,94 @@
+#ifndef SERIAL_H
+#define SERIAL_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdio.h>
+
+#include "logic.h"
+
+/* Binary format for expressions and results.
+ *
+ * A stream starts with the magic bytes "LEXB", a version byte and a flags
+ * byte. Then follow records, each one a kind byte, the length of the payload
+ * as a varint, and the payload:
+ *   'E' expression as tree: its nodes in prefix order, one tag byte per node;
+ *       a variable is followed by its number as a varint. Numbers 0 to 25
+ *       are the variables a to z; others must be named before their use.
+ *   'D' expression in the DAG section: nodes in postfix order. A tag byte
+ *       defines a new node from the nodes below it on the stack, and
+ *       SERIAL_REF followed by a varint pushes a node defined before.
+ *       Nodes are numbered in order of definition, and equal subexpressions
+ *       are defined only once per section.
+ *   'S' start of a new DAG section; numbering restarts at 0.
+ *   'N' name of a variable: its number as a varint, then the bytes of its
+ *       name. Numbers are those of the writer, and hold for the whole stream.
+ *   'R' result: the number of steps as a signed varint, its status as a
+ *       varint, the number of proof steps as a varint, and per proof step
+ *       the law number as a varint and the path as a varint length followed
+ *       by the path entries.
+ */
+
+#define SERIAL_VERSION 1
+
+/* Highest expression that is read, as the code that uses expressions
+ * recurses over them. Deeper records are errors.
+ */
+#define SERIAL_MAX_HEIGHT (1 << 16)
+
+/* Flags in the header.
+ */
+#define SERIAL_DAG 1
+
+/* Tag byte of back reference in DAG section.
+ */
+#define SERIAL_REF 6
+
+enum SerialKind {serialEnd, serialExpr, serialResult, serialError};
+
+/* A step in a proof: the number of a law in its law set, and the path
+ * at which it was applied (terminated by 0, as for searching laws).
+ */
+struct ProofStep {
+	int law;
+	int *path;
+};
+
+/* How far the number of steps in a result can be trusted.
+ */
+enum ResultStatus {
+	resultExact,      // shortest derivation, or -1 if there is none
+	resultExceeded,   // budget exceeded: shortest derivation found so far
+	resultApproximate // a filter may have cut the shortest derivation (see bfs.h)
+};
+
+/* Outcome of a search: number of steps (-1 if none) and optional proof.
+ */
+struct Result {
+	int steps;
+	enum ResultStatus status;
+	int n_proof;
+	struct ProofStep *proof;
+};
+
+struct SerialWriter;
+struct SerialReader;
+
+struct SerialWriter *serial_writer_open(FILE *out, int flags);
+bool serial_write_expr(struct SerialWriter *writer, struct Expr *expr);
+bool serial_write_result(struct SerialWriter *writer, struct Result *result);
+void serial_new_section(struct SerialWriter *writer);
+bool serial_writer_close(struct SerialWriter *writer);
+
+struct SerialReader *serial_reader_open(FILE *in);
+struct SerialReader *serial_reader_open_mem(const unsigned char *buf, size_t len);
+enum SerialKind serial_read(struct SerialReader *reader,
+		struct Expr **expr, struct Result *result);
+void serial_reader_close(struct SerialReader *reader);
+
+unsigned char *serial_encode_expr(struct Expr *expr, size_t *len);
+struct Expr *serial_decode_expr(const unsigned char *buf, size_t len);
+
+void free_result(struct Result *result);
+
+#endif // SERIAL_H
@@ -0,0 +1,76 @@
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "logic.h"
+#include "serial.h"
+
+/* Convert lines with expressions to LEXB, or LEXB to text.
+ */
+static int encode(bool dag) {
+	struct SerialWriter *writer = serial_writer_open(stdout, dag ? SERIAL_DAG : 0);
+	char *line = NULL;
+	size_t len = 0;
+	int status = 0;
+	while (getline(&line, &len, stdin) != -1) {
+		int size = strlen(line);
+		if (size >= 1 && line[size - 1] == '\n')
+			line[size - 1] = '\0';
+		struct Expr *expr = read_expr(line);
+		if (expr == NULL) {
+			status = 1;
+			continue;
+		}
+		serial_write_expr(writer, expr);
+		free_expr(expr);
+	}
+	free(line);
+	if (!serial_writer_close(writer)) {
+		fprintf(stderr, "Cannot write output\n");
+		status = 1;
+	}
+	return status;
+}
+
+static int decode() {
+	struct SerialReader *reader = serial_reader_open(stdin);
+	if (reader == NULL)
+		return 1;
+	struct Expr *expr;
+	struct Result result;
+	enum SerialKind kind;
+	while ((kind = serial_read(reader, &expr, &result)) != serialEnd) {
+		if (kind == serialError)
+			break;
+		if (kind == serialExpr) {
+			print_expr(expr);
+			printf("\n");
+			free_expr(expr);
+		} else {
+			if (result.status == resultExceeded)
+				printf("exceeded ");
+			else if (result.status == resultApproximate)
+				printf("approximate ");
+			printf("%d\n", result.steps);
+			for (int i = 0; i < result.n_proof; i++) {
+				printf("  %d at ", result.proof[i].law);
+				for (int j = 0; result.proof[i].path[j] > 0; j++)
+					printf("%d ", result.proof[i].path[j]);
+				printf("0\n");
+			}
+			free_result(&result);
+		}
+	}
+	serial_reader_close(reader);
+	return kind == serialError ? 1 : 0;
+}
+
+int main(int argc, char **argv) {
+	if (argc >= 2 && strcmp(argv[1], "encode") == 0)
+		return encode(argc >= 3 && strcmp(argv[2], "-dag") == 0);
+	if (argc >= 2 && strcmp(argv[1], "decode") == 0)
+		return decode();
+	fprintf(stderr, "Usage: %s encode [-dag] | decode\n", argv[0]);
+	return 2;
+}
@@ -0,0 +1,532 @@
+#include <errno.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "cache.h"
+#include "laws.h"
+#include "logic.h"
+#include "serial.h"
+#include "server.h"
+#include "simplify.h"
+#include "trace.h"
+#include "tt.h"
+
+/* Latencies are counted in buckets of powers of two microseconds.
+ */
+#define N_BUCKETS 32
+
+/* Most expressions in one request.
+ */
+#define MAX_REQUEST_LINES (1 << 20)
+
+/* A connection is freed when the client has gone and no jobs refer to it.
+ */
+struct Connection {
+	int fd;
+	pthread_mutex_t lock; // for writing, and for the fields below
+	int refs;
+};
+
+/* A 'solve' request, which is done when all its jobs are.
+ */
+struct Request {
+	int n;
+	int remaining; // protected by lock of connection
+};
+
+struct Job {
+	struct Job *next;
+	struct Connection *conn;
+	struct Request *request;
+	int index;
+	int law_set; // index in law_sets
+	int depth;
+	char *line;
+	struct timespec enqueued;
+};
+
+/* A search being done by a worker, which workers with the same key
+ * wait for instead of searching too. It is freed by the last of its
+ * worker and waiters to leave.
+ */
+struct Flight {
+	struct Flight *next;
+	unsigned char *key;
+	size_t len;
+	bool done;
+	int res;
+	bool exceeded;
+	int waiters;
+	pthread_cond_t finished;
+};
+
+struct Server {
+	pthread_mutex_t lock;
+	pthread_cond_t nonempty;
+	struct Job *head;
+	struct Job *tail;
+	long queue_depth;
+	long n_requests;
+	long n_done;
+	long n_errors;
+	long n_exceeded;
+	long latency[N_BUCKETS];
+	long n_leaks;           // queries that leaked memory, with mem_accounting
+	long query_peak_bytes;  // the most any query held
+	long worker_peak_bytes; // the most any worker held
+	int n_workers;
+	long n_coalesced;       // queries that waited for the same search
+	struct ResultCache *cache;
+	struct ResultCache *lines; // by law set, depth and the exact line
+	struct Flight *flights;    // searches being done, protected by lock
+	struct TransTable *tt; // shared by all workers, or NULL
+	struct Budget budget;
+	bool stopped;          // workers leave when set, protected by lock
+};
+
+static volatile sig_atomic_t stopping = 0;
+
+static void stop(int sig) {
+	(void) sig;
+	stopping = 1;
+}
+
+/* Write whole string, ignoring a client that has gone.
+ */
+static void send_line(struct Connection *conn, char *line) {
+	size_t len = strlen(line);
+	size_t done = 0;
+	while (done < len) {
+		ssize_t n = send(conn->fd, line + done, len - done, MSG_NOSIGNAL);
+		if (n <= 0) {
+			if (n < 0 && errno == EINTR)
+				continue;
+			return;
+		}
+		done += n;
+	}
+}
+
+static void release(struct Connection *conn) {
+	pthread_mutex_lock(&conn->lock);
+	bool last = --conn->refs == 0;
+	pthread_mutex_unlock(&conn->lock);
+	if (last) {
+		close(conn->fd);
+		pthread_mutex_destroy(&conn->lock);
+		free(conn);
+	}
+}
+
+static long micros_since(struct timespec *start) {
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return (now.tv_sec - start->tv_sec) * 1000000L + (now.tv_nsec - start->tv_nsec) / 1000;
+}
+
+/*******************************************/
+/* Workers.                                */
+/*******************************************/
+
+static void push_job(struct Server *server, struct Job *job) {
+	clock_gettime(CLOCK_MONOTONIC, &job->enqueued);
+	job->next = NULL;
+	pthread_mutex_lock(&server->lock);
+	if (server->tail == NULL)
+		server->head = job;
+	else
+		server->tail->next = job;
+	server->tail = job;
+	server->queue_depth++;
+	pthread_cond_signal(&server->nonempty);
+	pthread_mutex_unlock(&server->lock);
+}
+
+/* Next job, or NULL once the server has stopped.
+ */
+static struct Job *pop_job(struct Server *server) {
+	pthread_mutex_lock(&server->lock);
+	while (server->head == NULL && !server->stopped)
+		pthread_cond_wait(&server->nonempty, &server->lock);
+	if (server->stopped) {
+		pthread_mutex_unlock(&server->lock);
+		return NULL;
+	}
+	struct Job *job = server->head;
+	server->head = job->next;
+	if (server->head == NULL)
+		server->tail = NULL;
+	server->queue_depth--;
+	pthread_mutex_unlock(&server->lock);
+	return job;
+}
+
+/* Key of law set and depth followed by len bytes.
+ */
+static unsigned char *make_key(struct Job *job, void *bytes, size_t len) {
+	unsigned char *key = malloc(len + 2);
+	key[0] = (unsigned char) job->law_set;
+	key[1] = (unsigned char) job->depth;
+	memcpy(key + 2, bytes, len);
+	return key;
+}
+
+static void free_flight(struct Flight *flight) {
+	pthread_cond_destroy(&flight->finished);
+	free(flight->key);
+	free(flight);
+}
+
+/* Result of expr of job from the cache, or else search for it, or wait
+ * for the result if another worker is already searching for the same
+ * key. Caller holds server->lock. The cache is read with the lock held,
+ * as a worker puts its result there before it removes its flight, so
+ * that a key is either in the cache or in flight until it is searched.
+ */
+static int search_once(struct Server *server, struct Job *job, struct Expr *expr,
+		unsigned char *key, size_t len, bool *exceeded) {
+	int res;
+	if (cache_get(server->cache, key, len, &res))
+		return res;
+	struct Flight *flight = server->flights;
+	while (flight != NULL && (flight->len != len || memcmp(flight->key, key, len) != 0))
+		flight = flight->next;
+	if (flight != NULL) {
+		flight->waiters++;
+		server->n_coalesced++;
+		while (!flight->done)
+			pthread_cond_wait(&flight->finished, &server->lock);
+		res = flight->res;
+		*exceeded = flight->exceeded;
+		if (--flight->waiters == 0)
+			free_flight(flight);
+		return res;
+	}
+	flight = calloc(1, sizeof(struct Flight));
+	flight->key = malloc(len);
+	memcpy(flight->key, key, len);
+	flight->len = len;
+	pthread_cond_init(&flight->finished, NULL);
+	flight->next = server->flights;
+	server->flights = flight;
+	pthread_mutex_unlock(&server->lock);
+
+	struct LawSet *set = &law_sets[job->law_set];
+	struct Search search;
+	init_search(&search, job->depth, set->searches, set->applies, set->n_laws);
+	search.budget = server->budget;
+	search.tt = server->tt;
+	search.tt_salt = (job->law_set + 1) * 0x9e3779b97f4a7c15ULL;
+	res = search_derivation(&search, expr);
+	*exceeded = search.exceeded;
+	if (!search.exceeded)
+		cache_put(server->cache, key, len, res);
+
+	pthread_mutex_lock(&server->lock);
+	struct Flight **link = &server->flights;
+	while (*link != flight)
+		link = &(*link)->next;
+	*link = flight->next;
+	flight->done = true;
+	flight->res = res;
+	flight->exceeded = search.exceeded;
+	pthread_cond_broadcast(&flight->finished);
+	if (flight->waiters == 0)
+		free_flight(flight);
+	return res;
+}
+
+/* Result of job, from cache if possible. A line seen before for the
+ * same law set and depth is answered without reading it. Otherwise the
+ * key is the law set and depth, followed by the encoded expression with
+ * its variables renamed in order of first occurrence, and a search for
+ * a key that is being searched for by another worker is waited for.
+ * Results of searches that exceeded the budget are not cached.
+ * Return -2 if the expression cannot be parsed.
+ */
+static int solve(struct Server *server, struct Job *job, bool *exceeded) {
+	*exceeded = false;
+	size_t line_len = strlen(job->line);
+	unsigned char *line_key = make_key(job, job->line, line_len);
+	int res;
+	if (cache_get(server->lines, line_key, line_len + 2, &res)) {
+		free(line_key);
+		return res;
+	}
+	struct Expr *expr = read_expr(job->line);
+	if (expr == NULL) {
+		free(line_key);
+		return -2;
+	}
+	normalize_vars(expr);
+	size_t len;
+	unsigned char *code = serial_encode_expr(expr, &len);
+	unsigned char *key = make_key(job, code, len);
+	pthread_mutex_lock(&server->lock);
+	res = search_once(server, job, expr, key, len + 2, exceeded);
+	pthread_mutex_unlock(&server->lock);
+	if (!*exceeded)
+		cache_put(server->lines, line_key, line_len + 2, res);
+	free(line_key);
+	free(key);
+	free(code);
+	free_expr(expr);
+	return res;
+}
+
+static void *work(void *arg) {
+	struct Server *server = arg;
+	struct Job *job;
+	while ((job = pop_job(server)) != NULL) {
+		bool exceeded;
+		struct MemStats start, usage;
+		if (mem_accounting)
+			mem_query_begin(&start);
+		TRACE_BEGIN("line", job->index);
+		int res = solve(server, job, &exceeded);
+		TRACE_END("line");
+		bool leaked = mem_accounting && mem_query_end(&start, &usage);
+		char line[64];
+		if (res == -2)
+			snprintf(line, sizeof(line), "%d error\n", job->index);
+		else if (exceeded)
+			snprintf(line, sizeof(line), "%d exceeded %d\n", job->index, res);
+		else
+			snprintf(line, sizeof(line), "%d %d\n", job->index, res);
+
+		struct Connection *conn = job->conn;
+		pthread_mutex_lock(&conn->lock);
+		send_line(conn, line);
+		if (--job->request->remaining == 0) {
+			snprintf(line, sizeof(line), "done %d\n", job->request->n);
+			send_line(conn, line);
+			free(job->request);
+		}
+		pthread_mutex_unlock(&conn->lock);
+
+		long micros = micros_since(&job->enqueued);
+		int bucket = 0;
+		while (bucket < N_BUCKETS - 1 && (1L << bucket) < micros)
+			bucket++;
+		pthread_mutex_lock(&server->lock);
+		server->latency[bucket]++;
+		server->n_done++;
+		if (res == -2)
+			server->n_errors++;
+		if (exceeded)
+			server->n_exceeded++;
+		if (mem_accounting) {
+			if (leaked)
+				server->n_leaks++;
+			if (usage.peak_bytes > server->query_peak_bytes)
+				server->query_peak_bytes = usage.peak_bytes;
+			if (mem_stats.peak_bytes > server->worker_peak_bytes)
+				server->worker_peak_bytes = mem_stats.peak_bytes;
+		}
+		pthread_mutex_unlock(&server->lock);
+
+		release(conn);
+		free(job->line);
+		free(job);
+	}
+	return NULL;
+}
+
+/*******************************************/
+/* Connections.                            */
+/*******************************************/
+
+static void send_stats(struct Server *server, struct Connection *conn) {
+	long hits, misses, entries, line_hits, line_misses, line_entries;
+	cache_stats(server->cache, &hits, &misses, &entries);
+	cache_stats(server->lines, &line_hits, &line_misses, &line_entries);
+	char buf[4096];
+	int pos = 0;
+	pthread_mutex_lock(&server->lock);
+	pos += snprintf(buf + pos, sizeof(buf) - pos,
+			"workers %d\nqueue_depth %ld\nrequests %ld\nformulas_done %ld\nformulas_error %ld\n"
+			"formulas_exceeded %ld\nformulas_coalesced %ld\n",
+			server->n_workers, server->queue_depth, server->n_requests,
+			server->n_done, server->n_errors, server->n_exceeded, server->n_coalesced);
+	for (int i = 0; i < N_BUCKETS; i++)
+		if (server->latency[i] > 0)
+			pos += snprintf(buf + pos, sizeof(buf) - pos, "latency_us_le_%ld %ld\n",
+					1L << i, server->latency[i]);
+	if (mem_accounting)
+		pos += snprintf(buf + pos, sizeof(buf) - pos,
+				"memory_query_peak_bytes %ld\nmemory_worker_peak_bytes %ld\nmemory_leaks %ld\n",
+				server->query_peak_bytes, server->worker_peak_bytes, server->n_leaks);
+	pthread_mutex_unlock(&server->lock);
+	if (server->tt != NULL)
+		pos += snprintf(buf + pos, sizeof(buf) - pos, "tt_entries %ld\n", tt_entries(server->tt));
+	pos += snprintf(buf + pos, sizeof(buf) - pos, "line_cache_hits %ld\nline_cache_entries %ld\n",
+			line_hits, line_entries);
+	pos += snprintf(buf + pos, sizeof(buf) - pos,
+			"cache_hits %ld\ncache_misses %ld\ncache_entries %ld\ncache_hit_rate %.3f\nend\n",
+			hits, misses, entries, hits + misses > 0 ? (double) hits / (hits + misses) : 0.0);
+	pthread_mutex_lock(&conn->lock);
+	send_line(conn, buf);
+	pthread_mutex_unlock(&conn->lock);
+}
+
+struct Client {
+	struct Server *server;
+	struct Connection *conn;
+};
+
+/* Read requests from client and queue their jobs.
+ */
+static void *serve_client(void *arg) {
+	struct Client *client = arg;
+	struct Server *server = client->server;
+	struct Connection *conn = client->conn;
+	free(client);
+	FILE *in = fdopen(dup(conn->fd), "r");
+	char *line = NULL;
+	size_t len = 0;
+	while (in != NULL && getline(&line, &len, in) != -1) {
+		line[strcspn(line, "\r\n")] = '\0';
+		char name[32];
+		int depth, n;
+		if (strcmp(line, "quit") == 0)
+			break;
+		if (strcmp(line, "stats") == 0) {
+			send_stats(server, conn);
+			continue;
+		}
+		struct LawSet *set = NULL;
+		if (sscanf(line, "solve %31s %d %d", name, &depth, &n) != 3 ||
+				(set = find_law_set(name)) == NULL || depth < 0 || depth > 255 || n < 0 ||
+				n > MAX_REQUEST_LINES) {
+			pthread_mutex_lock(&conn->lock);
+			send_line(conn, "error bad request\n");
+			pthread_mutex_unlock(&conn->lock);
+			continue;
+		}
+		pthread_mutex_lock(&server->lock);
+		server->n_requests++;
+		pthread_mutex_unlock(&server->lock);
+		struct Request *request = malloc(sizeof(struct Request));
+		request->n = n;
+		request->remaining = n;
+		if (n == 0) {
+			free(request);
+			pthread_mutex_lock(&conn->lock);
+			send_line(conn, "done 0\n");
+			pthread_mutex_unlock(&conn->lock);
+			continue;
+		}
+		// the request must count all its jobs before any can finish
+		pthread_mutex_lock(&conn->lock);
+		conn->refs += n;
+		pthread_mutex_unlock(&conn->lock);
+		int i = 0;
+		for (; i < n && getline(&line, &len, in) != -1; i++) {
+			struct Job *job = malloc(sizeof(struct Job));
+			job->conn = conn;
+			job->request = request;
+			job->index = i;
+			job->law_set = set - law_sets;
+			job->depth = depth == 0 ? set->max_depth : depth;
+			line[strcspn(line, "\r\n")] = '\0';
+			job->line = strdup(line);
+			push_job(server, job);
+		}
+		if (i < n) { // the input ended: the request is the lines that came
+			pthread_mutex_lock(&conn->lock);
+			conn->refs -= n - i;
+			request->n = i;
+			request->remaining -= n - i;
+			if (request->remaining == 0) {
+				char done[32];
+				snprintf(done, sizeof(done), "done %d\n", i);
+				send_line(conn, done);
+				free(request);
+			}
+			pthread_mutex_unlock(&conn->lock);
+		}
+	}
+	free(line);
+	if (in != NULL)
+		fclose(in);
+	shutdown(conn->fd, SHUT_RD);
+	release(conn);
+	return NULL;
+}
+
+/* Listen on socket until interrupted, then wait for the searches of
+ * the workers to end. Jobs still queued are dropped. Return 0 on normal end.
+ */
+int serve(char *socket_path, int n_workers, size_t cache_capacity, size_t tt_slots,
+		struct Budget *budget) {
+	struct sockaddr_un addr;
+	memset(&addr, 0, sizeof(addr));
+	addr.sun_family = AF_UNIX;
+	if (strlen(socket_path) >= sizeof(addr.sun_path)) {
+		fprintf(stderr, "Socket path too long: %s\n", socket_path);
+		return 1;
+	}
+	strcpy(addr.sun_path, socket_path);
+	int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+	unlink(socket_path);
+	if (fd < 0 || bind(fd, (struct sockaddr *) &addr, sizeof(addr)) < 0 || listen(fd, 64) < 0) {
+		perror(socket_path);
+		return 1;
+	}
+
+	struct sigaction action;
+	memset(&action, 0, sizeof(action));
+	action.sa_handler = stop; // no SA_RESTART, so that accept is interrupted
+	sigaction(SIGINT, &action, NULL);
+	sigaction(SIGTERM, &action, NULL);
+	signal(SIGPIPE, SIG_IGN);
+
+	struct Server *server = calloc(1, sizeof(struct Server));
+	pthread_mutex_init(&server->lock, NULL);
+	pthread_cond_init(&server->nonempty, NULL);
+	server->n_workers = n_workers;
+	server->cache = cache_new(cache_capacity);
+	server->lines = cache_new(cache_capacity);
+	server->tt = tt_slots > 0 ? tt_new(tt_slots) : NULL;
+	server->budget = *budget;
+	pthread_t workers[n_workers];
+	for (int i = 0; i < n_workers; i++)
+		pthread_create(&workers[i], NULL, work, server);
+
+	while (!stopping) {
+		int client_fd = accept(fd, NULL, NULL);
+		if (client_fd < 0) {
+			if (errno != EINTR)
+				perror("accept");
+			continue;
+		}
+		struct Connection *conn = malloc(sizeof(struct Connection));
+		conn->fd = client_fd;
+		conn->refs = 1;
+		pthread_mutex_init(&conn->lock, NULL);
+		struct Client *client = malloc(sizeof(struct Client));
+		client->server = server;
+		client->conn = conn;
+		pthread_t thread;
+		pthread_create(&thread, NULL, serve_client, client);
+		pthread_detach(thread);
+	}
+	close(fd);
+	unlink(socket_path);
+	// the workers must be done with their traces before they are exported
+	pthread_mutex_lock(&server->lock);
+	server->stopped = true;
+	pthread_cond_broadcast(&server->nonempty);
+	pthread_mutex_unlock(&server->lock);
+	for (int i = 0; i < n_workers; i++)
+		pthread_join(workers[i], NULL);
+	return 0;
+}
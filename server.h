@@ -0,0 +1,39 @@
+#ifndef SERVER_H
+#define SERVER_H
+
+#include <stddef.h>
+
+#include "simplify.h"
+
+/* Server answering requests on a Unix domain socket.
+ * The protocol is line based. A request is one of:
+ *   solve <law set> <depth> <n>   followed by n lines with expressions;
+ *                                 depth 0 means the default of the law set.
+ *                                 Answered by lines "<i> <steps>" (or
+ *                                 "<i> error", or "<i> exceeded <steps>"
+ *                                 if the budget was exceeded) in the order
+ *                                 in which the results are found, where i
+ *                                 counts from 0, then "done <n>".
+ *                                 n is at most MAX_REQUEST_LINES (2^20).
+ *                                 If the input ends before the n lines,
+ *                                 the lines that came are answered, and
+ *                                 then "done" with their number.
+ *   stats                         Answered by lines "<name> <value>",
+ *                                 then "end". With mem_accounting, these
+ *                                 include the peak memory of queries and
+ *                                 of workers, and the number of leaks.
+ *   quit                          Close the connection.
+ * Searches are done by a pool of worker threads, shared by all connections,
+ * and results are cached for later requests, both by the exact line and
+ * by the expression up to renaming of variables. A worker that needs the
+ * result of a search that another worker is doing waits for it, rather
+ * than doing the same search. The workers also share
+ * a transposition table of tt_slots slots (none if 0).
+ * On SIGINT or SIGTERM, serve stops accepting connections and returns
+ * once the searches in progress have ended.
+ */
+
+int serve(char *socket_path, int n_workers, size_t cache_capacity, size_t tt_slots,
+		struct Budget *budget);
+
+#endif // SERVER_H
@@ -2,17 +2,411 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include "bdd.h"
+#include "bfs.h"
+#include "cache.h"
+#include "dimacs.h"
+#include "greedy.h"
 #include "laws.h"
 #include "logic.h"
+#include "serial.h"
+#include "simplify.h"
+#include "trace.h"
+#include "tt.h"
 
+struct Options run_options;
+
+/* Number of results remembered in a run.
+ */
+#define MEMO_ENTRIES (1 << 16)
+
+/* Default number of slots of the transposition table (of 16 bytes).
+ */
+#define TT_SLOTS (1 << 20)
+
+/* Most BDD nodes used to check whether an expression is a tautology
+ * before searching.
+ */
+#define PREFILTER_NODES (1L << 16)
+
+/* Bytes of the expressions of a run of a breadth-first search on disk,
+ * if there is no limit with -m.
+ */
+#define BFS_MEMORY (64L << 20)
+
+/* Node arrays of the expressions on the current search path, by depth.
+ */
+static __thread struct NodeArray scan_levels[256];
+
+/* Number of trace events kept per thread.
+ */
+#define TRACE_EVENTS (1 << 20)
+
+/* Weights of laws read with -p, which the history of searches starts from.
+ */
+#define MAX_PROFILE 64
+
+static struct
+{
+  LawSearch search;
+  long weight;
+} profile[MAX_PROFILE];
+static int n_profile;
+
+/* Table given with -L.
+ */
+static struct AnswerTable *answer_table;
+
+/* History weights are halved when one gets above this.
+ */
+#define MAX_HISTORY (1L << 40)
+
+/**
+ * @brief Function to read a size such as 512, 64k, 100m or 2g
+ * 
+ * @param char *str - the string to read
+ * @param long *size - where to store the size
+ * 
+ * @return bool - whether the string is a valid size
+ */
+bool parse_size(char *str, long *size)
+{
+  char *end;
+  *size = strtol(str, &end, 10);
+  switch (*end)
+  {
+  case 'k':
+  case 'K':
+    *size <<= 10;
+    end++;
+    break;
+  case 'm':
+  case 'M':
+    *size <<= 20;
+    end++;
+    break;
+  case 'g':
+  case 'G':
+    *size <<= 30;
+    end++;
+    break;
+  }
+  return end != str && *end == '\0' && *size >= 0;
+}
+
+/**
+ * @brief Function to read a profile of weights of laws for move ordering
+ * - each line is a weight and the name of a law, as in the law sets
+ * 
+ * @param char *file_name - the profile
+ * 
+ * @return bool - whether the profile could be read; if not, why is printed
+ */
+static bool read_profile(char *file_name)
+{
+  FILE *file = fopen(file_name, "r");
+  if (file == NULL)
+  {
+    perror(file_name);
+    return false;
+  }
+  char *line = NULL;
+  size_t len = 0;
+  bool ok = true;
+  n_profile = 0;
+  while (ok && getline(&line, &len, file) != -1)
+  {
+    int size = strlen(line);
+    if (size >= 1 && line[size - 1] == '\n')
+      line[size - 1] = '\0';
+    char *name;
+    long weight = strtol(line, &name, 10);
+    LawSearch search = *name == ' ' ? find_law(name + 1) : NULL;
+    if (search == NULL || weight < 0 || n_profile == MAX_PROFILE)
+    {
+      fprintf(stderr, "%s: bad line %s\n", file_name, line);
+      ok = false;
+      break;
+    }
+    profile[n_profile].search = search;
+    profile[n_profile].weight = weight;
+    n_profile++;
+  }
+  free(line);
+  fclose(file);
+  return ok;
+}
+
+/**
+ * @brief Function to write the weights of laws learned by a search
+ * to the profile given with -P, if any
+ * 
+ * @param struct Search *search - the search
+ * 
+ * @return void
+ */
+static void write_profile(struct Search *search)
+{
+  if (run_options.profile_out == NULL || !search->ordering)
+    return;
+  FILE *file = fopen(run_options.profile_out, "w");
+  if (file == NULL)
+  {
+    perror(run_options.profile_out);
+    return;
+  }
+  for (int i = 0; i < search->n_laws; i++)
+    fprintf(file, "%ld %s\n", search->history[i], law_name(search->searches[i]));
+  fclose(file);
+}
+
+/**
+ * @brief Function to set run_options from the command line
+ * - -b: read and write binary (LEXB) streams instead of text
+ * - -G: do not start searches with a bound from the greedy normalizer
+ * - -B: do not check with a BDD whether expressions are tautologies
+ *   before searching
+ * - -E dir: search breadth first, with the expressions of each depth in
+ *   files in dir, for searches that do not fit in memory; the memory for
+ *   the expressions of a run is that of -m, or 64 MB
+ * - -A bytes: search breadth first in memory instead, with the
+ *   expressions of earlier depths in a Bloom filter of this many bytes,
+ *   and those of the last depths in the memory of -m, or 64 MB; results
+ *   that may not be the shortest, as the filter may have cut the
+ *   shortest derivation, are printed as "approximate n"
+ * - -s states: expand at most this many expressions per input line
+ * - -m bytes: hold at most this much memory in expressions per input line
+ * - -t millis: spend at most this much time per input line
+ * - -H slots: use a transposition table of this many slots (0 for none),
+ *   shared by the searches of all input lines
+ * - -I: rewrite one working tree in place and undo the rewrites when
+ *   backtracking, instead of making a new expression for each step
+ * - -F: try the laws in the order of the law set, without move ordering
+ * - -R: search all orders of rewrites at positions apart from each other,
+ *   without partial-order reduction (which is only done with -H 0)
+ * - -p profile: start the move ordering from the weights of laws in
+ *   profile, as written by -P
+ * - -P profile: write the weights of laws learned in the run to profile,
+ *   so that a profile can be learned from a corpus
+ * - -L table: look up the results of small expressions in table, as
+ *   made by make_table, instead of searching
+ * - -M: count the memory held in expressions and paths, and report
+ *   the peaks and any leaks of each input line on standard error
+ * - -T prefix: trace the search, and write the trace to prefix.json
+ *   (Chrome trace events) and prefix.folded (folded stacks)
+ * - files after the options are DIMACS files (see dimacs.h), which are
+ *   the inputs instead of the lines of standard input, one result each;
+ *   they cannot be given with -b
+ * 
+ * @param int argc - the number of arguments
+ * @param char **argv - the arguments
+ * 
+ * @return bool - whether the options are valid; if not, usage is printed
+ */
+bool parse_options(int argc, char **argv)
+{
+  memset(&run_options, 0, sizeof(run_options));
+  run_options.tt_slots = TT_SLOTS;
+  int opt;
+  bool ok = true;
+  while (ok && (opt = getopt(argc, argv, "A:bBE:FGH:IL:Mp:P:Rs:m:t:T:")) != -1)
+  {
+    switch (opt)
+    {
+    case 'A':
+      ok = parse_size(optarg, &run_options.bfs_filter) && run_options.bfs_filter > 0;
+      break;
+    case 'b':
+      run_options.binary = true;
+      break;
+    case 'B':
+      run_options.no_prefilter = true;
+      break;
+    case 'E':
+      run_options.bfs_dir = optarg;
+      break;
+    case 'F':
+      run_options.fixed_order = true;
+      break;
+    case 'G':
+      run_options.no_greedy = true;
+      break;
+    case 'H':
+      ok = parse_size(optarg, &run_options.tt_slots);
+      break;
+    case 'I':
+      run_options.in_place = true;
+      break;
+    case 'L':
+      run_options.table = optarg;
+      answer_table = table_open(optarg);
+      ok = answer_table != NULL;
+      break;
+    case 'M':
+      mem_accounting = true;
+      break;
+    case 'p':
+      run_options.profile = optarg;
+      ok = read_profile(optarg);
+      break;
+    case 'P':
+      run_options.profile_out = optarg;
+      break;
+    case 'R':
+      run_options.no_reduction = true;
+      break;
+    case 's':
+      ok = parse_size(optarg, &run_options.budget.max_states);
+      break;
+    case 'm':
+      ok = parse_size(optarg, &run_options.budget.max_bytes);
+      break;
+    case 't':
+      ok = parse_size(optarg, &run_options.budget.max_millis);
+      break;
+    case 'T':
+      run_options.trace_prefix = optarg;
+      trace_enable(TRACE_EVENTS);
+      break;
+    default:
+      ok = false;
+      break;
+    }
+  }
+  run_options.dimacs_files = argv + optind;
+  run_options.n_dimacs_files = argc - optind;
+  if (!ok || (run_options.binary && optind != argc))
+  {
+    fprintf(stderr, "Usage: %s [-A filter bytes] [-b] [-B] [-E dir] [-F] [-G] [-H slots] [-I] [-L table] [-M] [-p profile] [-P profile] [-R] [-s max states] [-m max bytes] [-t max millis] [-T trace prefix] [DIMACS file ...]\n", argv[0]);
+    return false;
+  }
+  return true;
+}
+
+/**
+ * @brief Function to write the trace, if tracing was asked for with -T
+ * 
+ * @return void
+ */
+static void write_trace()
+{
+  if (run_options.trace_prefix == NULL)
+    return;
+  size_t len = strlen(run_options.trace_prefix) + 8;
+  char file_name[len];
+  snprintf(file_name, len, "%s.json", run_options.trace_prefix);
+  trace_export_chrome(file_name);
+  snprintf(file_name, len, "%s.folded", run_options.trace_prefix);
+  trace_export_folded(file_name);
+}
+
+/**
+ * @brief Function to get the next input: the name of the next DIMACS file
+ * of run_options, if there are any, or else the next line of standard input
+ * 
+ * @param char **line - the input, in a buffer as of getline
+ * @param size_t *len - the size of the buffer
+ * @param int *n_files - the number of files so far, counted up
+ * 
+ * @return bool - whether there was another input
+ */
+static bool next_input(char **line, size_t *len, int *n_files)
+{
+  if (run_options.n_dimacs_files == 0)
+    return getline(line, len, stdin) != -1;
+  if (*n_files == run_options.n_dimacs_files)
+    return false;
+  char *file_name = run_options.dimacs_files[(*n_files)++];
+  size_t size = strlen(file_name) + 1;
+  if (size > *len)
+  {
+    *line = realloc(*line, size);
+    *len = size;
+  }
+  memcpy(*line, file_name, size);
+  return true;
+}
+
+/**
+ * @brief Function to read the expression of an input from next_input
+ * - errors are reported by read_expr or read_dimacs
+ * 
+ * @param char *line - the input, without a newline
+ * 
+ * @return struct Expr * - the expression, or NULL if it cannot be read
+ */
+static struct Expr *read_input(char *line)
+{
+  return run_options.n_dimacs_files > 0 ? read_dimacs(line) : read_expr(line);
+}
+
+/**
+ * @brief Function to report the memory of an input line, with -M
+ * - peaks are relative to what was live before the line
+ * - anything still live after the line has leaked
+ * 
+ * @param int line_number - the number of the input line, from 1
+ * @param struct MemStats *start - the counters saved by mem_query_begin
+ * 
+ * @return void
+ */
+static void report_memory(int line_number, struct MemStats *start)
+{
+  struct MemStats usage;
+  bool leaked = mem_query_end(start, &usage);
+  fprintf(stderr, "memory line %d: peak %ld nodes %ld paths %ld bytes\n", line_number,
+          usage.peak_nodes, usage.peak_paths, usage.peak_bytes);
+  if (leaked)
+    fprintf(stderr, "leak line %d: %ld nodes %ld paths %ld bytes\n", line_number,
+            usage.nodes, usage.paths, usage.bytes);
+}
+
+/**
+ * @brief Function to find the shortest derivation, reusing the results of
+ * earlier expressions that are the same up to renaming of variables
+ * - rename the variables of the expression in order of first occurrence
+ * - look up small expressions in the answer table, if any
+ * - look up the encoded expression in the memo, or search and store it
+ * - results of searches that exceeded the budget, or that are
+ *   approximate, are not stored
+ * 
+ * @param struct Search *search - the search, prepared by init_search
+ * @param struct ResultCache *memo - the results of this run
+ * @param struct Expr *expr_tree - the expression, which is renamed
+ * 
+ * @return int - the number of steps of the shortest derivation, or -1
+ */
+static int derivation_with_memo(struct Search *search, struct ResultCache *memo,
+                                struct Expr *expr_tree)
+{
+  normalize_vars(expr_tree);
+  int res;
+  search->exceeded = false;
+  search->approximate = false;
+  if (search->table != NULL && table_lookup(search->table, search->table_column, expr_tree, &res))
+    return res;
+  size_t len;
+  unsigned char *key = serial_encode_expr(expr_tree, &len);
+  if (!cache_get(memo, key, len, &res))
+  {
+    res = search_derivation(search, expr_tree);
+    if (!search->exceeded && !search->approximate)
+      cache_put(memo, key, len, res);
+  }
+  free(key);
+  return res;
+}
 
-int apply(struct Expr *expr_tree, int cur_depth, int max_depth, LawSearch searches[],
-          LawApplication applies[], int n_laws);
 /* 
  * @brief This function is to parse the expression into the struct tree and output
- * - Read lines with expressions from standard input.
+ * - Read lines with expressions from standard input, or the DIMACS
+ *   files of run_options.
  * - Find derivations from each expression.
  * - Use the indicated laws.
+ * - Answer a line seen before from its first result, without reading it,
+ *   and an expression seen before up to renaming of variables from the memo.
  * 
  * @param int max_depth - the max depth (usually 6) and the threshold
  * @param LawSearch searches[] - the array contains all searching methods
@@ -26,19 +420,121 @@ void find_derivations_for_strings(int max_depth, LawSearch searches[],
                                   LawApplication applies[], char *names[],
                                   int n_laws)
 {
+  struct Search search;
+  init_search(&search, max_depth, searches, applies, n_laws);
+  if (run_options.tt_slots > 0)
+    search.tt = tt_new(run_options.tt_slots);
+  struct ResultCache *memo = cache_new(MEMO_ENTRIES);
+  struct ResultCache *lines = cache_new(MEMO_ENTRIES); // by the exact line
   char *line = NULL;
   size_t len = 0;
-  while (getline(&line, &len, stdin) != -1)
+  int line_number = 0;
+  int n_files = 0;
+  while (next_input(&line, &len, &n_files))
   {
     int size = strlen(line);
     if (size >= 1 && line[size - 1] == '\n')
-      line[size - 1] = '\0';
+      line[--size] = '\0';
+
+    struct MemStats start;
+    if (mem_accounting)
+      mem_query_begin(&start);
+    line_number++;
+    TRACE_BEGIN("line", line_number);
+    int res;
+    struct Expr *expr_tree;
+    if (cache_get(lines, (unsigned char *) line, size, &res)) // a repeated line
+      printf("%d\n", res);
+    else if ((expr_tree = read_input(line)) == NULL) // reported by read_input
+      printf("error\n");
+    else
+    {
+      res = derivation_with_memo(&search, memo, expr_tree);
+      if (search.exceeded) // only an upper bound
+        printf("exceeded %d\n", res);
+      else if (search.approximate) // also
+        printf("approximate %d\n", res);
+      else
+      {
+        printf("%d\n", res);
+        cache_put(lines, (unsigned char *) line, size, res);
+      }
+      free_expr(expr_tree);
+    }
+    TRACE_END("line");
+    if (mem_accounting)
+      report_memory(line_number, &start);
+  }
+  free(line);
+  cache_free(lines);
+  cache_free(memo);
+  if (search.tt != NULL)
+    tt_free(search.tt);
+  write_profile(&search);
+  write_trace();
+}
 
-    struct Expr *expr_tree = read_expr(line); // read expression
-    int res = apply(expr_tree, max_depth, max_depth, searches, applies, n_laws);
-    printf("%d\n", res);
+/**
+ * @brief Same as find_derivations_for_strings, but on binary streams
+ * - Read LEXB expression records from standard input (see serial.h).
+ * - Write one LEXB result record per expression to standard output.
+ * 
+ * @param int max_depth - the max depth (usually 6) and the threshold
+ * @param LawSearch searches[] - the array contains all searching methods
+ * @param LawApplication applies[] - the array contains all applying methods
+ * @param int n_laws - the total number of laws
+ * 
+ * @return void
+ */
+void find_derivations_for_binary(int max_depth, LawSearch searches[],
+                                 LawApplication applies[], int n_laws)
+{
+  struct SerialReader *reader = serial_reader_open(stdin);
+  if (reader == NULL)
+    return;
+  struct SerialWriter *writer = serial_writer_open(stdout, 0);
+  struct Search search;
+  init_search(&search, max_depth, searches, applies, n_laws);
+  if (run_options.tt_slots > 0)
+    search.tt = tt_new(run_options.tt_slots);
+  struct ResultCache *memo = cache_new(MEMO_ENTRIES);
+  struct Expr *expr_tree;
+  struct Result result;
+  enum SerialKind kind;
+  int line_number = 0;
+  while ((kind = serial_read(reader, &expr_tree, &result)) != serialEnd)
+  {
+    if (kind == serialError)
+      break;
+    if (kind == serialResult) // results are passed on unchanged
+    {
+      serial_write_result(writer, &result);
+      free_result(&result);
+      continue;
+    }
+    struct MemStats start;
+    if (mem_accounting)
+      mem_query_begin(&start);
+    line_number++;
+    TRACE_BEGIN("line", line_number);
+    result.steps = derivation_with_memo(&search, memo, expr_tree);
+    TRACE_END("line");
+    result.status = search.exceeded ? resultExceeded :
+                    search.approximate ? resultApproximate : resultExact;
+    result.n_proof = 0;
+    result.proof = NULL;
+    serial_write_result(writer, &result);
+    if (mem_accounting) // the expression itself is not counted
+      report_memory(line_number, &start);
     free_expr(expr_tree);
   }
+  serial_writer_close(writer);
+  serial_reader_close(reader);
+  cache_free(memo);
+  if (search.tt != NULL)
+    tt_free(search.tt);
+  write_profile(&search);
+  write_trace();
 }
 
 /**
@@ -122,11 +618,885 @@ int apply(struct Expr *expr_tree, int cur_depth, int max_depth, LawSearch search
       cur_path = searches[i](expr_tree, cur_path);
 
       free_expr(cur_expr); // free all malloced things
-      free(temp_path);
+      free_path(temp_path);
     }
-    free(cur_path);
+    free_path(cur_path);
     free_expr(cur);
   }
-  free(path);
+  free_path(path);
   return min_deri(n_laws, deri, max_depth); // find the shortest value
 }
+
+/**
+ * @brief Function to prepare a search with the limits in run_options
+ * - positions of laws are found with node arrays if all laws have infos
+ * - searches are cut with the lower bound of laws_to_true if all laws
+ *   have infos
+ * - with run_options.in_place, laws are rewritten in place if all
+ *   laws have infos
+ * - unless run_options.fixed_order, laws are tried in order of move
+ *   ordering if all laws have infos, starting from the profile
+ * - the answer table of run_options.table is used if it has the law set
+ *   with max_depth
+ * - unless run_options.no_reduction, rewrites at positions apart from
+ *   each other are only searched in one order, if there is no
+ *   transposition table
+ * - with run_options.bfs_dir, expressions are searched breadth first
+ *   with the levels on disk instead, and with run_options.bfs_filter,
+ *   in memory with a filter for the levels before the last ones
+ * 
+ * @param struct Search *search - the search to prepare
+ * @param int max_depth - the max depth (usually 6) and the threshold
+ * @param LawSearch searches[] - the array contains all searching methods
+ * @param LawApplication applies[] - the array contains all applying methods
+ * @param int n_laws - the total number of laws
+ * 
+ * @return void
+ */
+void init_search(struct Search *search, int max_depth, LawSearch searches[],
+                 LawApplication applies[], int n_laws)
+{
+  memset(search, 0, sizeof(struct Search));
+  search->searches = searches;
+  search->applies = applies;
+  search->n_laws = n_laws;
+  search->max_depth = max_depth;
+  bool have_infos = n_laws <= MAX_SCAN_LAWS;
+  for (int i = 0; i < n_laws && have_infos; i++)
+  {
+    search->infos[i] = law_info(searches[i]);
+    if (search->infos[i] == NULL)
+      have_infos = false;
+  }
+  search->scan = have_infos && max_depth <= 256;
+  search->bound = have_infos;
+  search->in_place = have_infos && run_options.in_place;
+  search->ordering = have_infos && max_depth <= 256 && !run_options.fixed_order;
+  for (int i = 0; i < n_laws && search->ordering; i++)
+    for (int j = 0; j < n_profile; j++)
+      if (profile[j].search == searches[i])
+        search->history[i] = profile[j].weight;
+  for (int steps = 0; steps < 256; steps++)
+    search->killers[steps] = -1;
+  search->reduce = !run_options.no_reduction;
+  search->greedy = !run_options.no_greedy;
+  search->prefilter = !run_options.no_prefilter;
+  search->bfs_dir = run_options.bfs_dir;
+  search->bfs_filter = run_options.bfs_filter;
+  search->budget = run_options.budget;
+  if (answer_table != NULL)
+  {
+    search->table_column = table_column(answer_table, searches, max_depth);
+    if (search->table_column != -1)
+      search->table = answer_table;
+  }
+}
+
+/**
+ * @brief Function to check the budget, which stays exceeded once it is
+ * - the clock is only read after CLOCK_WORK (see bfs.h), as this is slow
+ * 
+ * @param struct Search *search - the current search
+ * 
+ * @return bool - whether the budget is exceeded
+ */
+static bool over_budget(struct Search *search)
+{
+  struct Budget *budget = &search->budget;
+  if (budget->max_states > 0 && search->states >= budget->max_states)
+    search->exceeded = true;
+  if (budget->max_bytes > 0 && search->bytes > budget->max_bytes)
+    search->exceeded = true;
+  if (budget->max_millis > 0 && search->work >= CLOCK_WORK)
+  {
+    search->work = 0;
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    long millis = (now.tv_sec - search->start.tv_sec) * 1000 +
+                  (now.tv_nsec - search->start.tv_nsec) / 1000000;
+    if (millis >= budget->max_millis)
+      search->exceeded = true;
+  }
+  return search->exceeded;
+}
+
+/**
+ * @brief Function to estimate the memory held for an expression and its path
+ * 
+ * @param struct Expr *expr_tree - the expression
+ * @param int depth - the length of the path
+ * 
+ * @return long - the number of bytes
+ */
+static long bytes_of(struct Expr *expr_tree, int depth)
+{
+  return size_expr(expr_tree) * (long)sizeof(struct Expr) + (depth + 1) * (long)sizeof(int);
+}
+
+/**
+ * @brief Function to find the next position where law i applies
+ * - with the node array of the expression, if any, after match_laws
+ * - else with the search function of the law
+ * 
+ * @param struct Search *search - the current search
+ * @param struct NodeArray *nodes - the node array of the expression, or NULL
+ * @param int i - the law
+ * @param struct Expr *expr_tree - the expression
+ * @param int *cur_path - the current position, or NULL for the first
+ * @param int *index - the index in the node array of the current
+ *   position (-1 for the first), updated to that of the next
+ * 
+ * @return int* - the path of the next position, or NULL if there is none
+ */
+static int *next_law_position(struct Search *search, struct NodeArray *nodes, int i,
+                              struct Expr *expr_tree, int *cur_path, int *index)
+{
+  if (nodes != NULL)
+  {
+    *index = next_match(nodes, search->infos[i], i, *index + 1);
+    return *index == -1 ? NULL : path_to(nodes, *index);
+  }
+  if (cur_path != NULL)
+    return search->searches[i](expr_tree, cur_path);
+  int *path = non_path();
+  int *first = search->searches[i](expr_tree, path);
+  free_path(path);
+  return first;
+}
+
+/**
+ * @brief Function to find the next position where law i applies, as
+ * next_law_position, that the search has to try
+ * - with search->reduce, positions apart from and to the left of that
+ *   of the step to the expression are skipped: a derivation with that
+ *   step and then one of these can be reordered into one with the same
+ *   steps, in which the step to the left comes first, so that a shortest
+ *   derivation is still found (partial-order reduction)
+ * - the result of a search from an expression then depends on the step
+ *   to it, so this is not done with a transposition table, which
+ *   already searches only once from an expression reached in both orders
+ * 
+ * @param struct Search *search - the current search
+ * @param struct NodeArray *nodes - the node array of the expression, or NULL
+ * @param int i - the law
+ * @param struct Expr *expr_tree - the expression
+ * @param int *cur_path - the current position, or NULL for the first
+ * @param int *index - as for next_law_position
+ * @param int *last - the position of the step to the expression, or NULL
+ * 
+ * @return int* - the path of the next position, or NULL if there is none
+ */
+static int *next_position(struct Search *search, struct NodeArray *nodes, int i,
+                          struct Expr *expr_tree, int *cur_path, int *index, int *last)
+{
+  int *path = next_law_position(search, nodes, i, expr_tree, cur_path, index);
+  while (search->reduce && search->tt == NULL && last != NULL && path != NULL &&
+         path_left_of(path, last))
+  {
+    int *next_path = next_law_position(search, nodes, i, expr_tree, path, index);
+    free_path(path);
+    path = next_path;
+  }
+  return path;
+}
+
+/**
+ * @brief Function to give the order in which to try the laws on an
+ * expression, by move ordering
+ * - first the killer: the law that last led to a derivation from an
+ *   expression at the same depth
+ * - then the laws that make expressions smaller, as these lead to T
+ * - then by history: the weight of the derivations laws led to
+ * - else in the order of the law set
+ * 
+ * @param struct Search *search - the current search
+ * @param int steps - the depth of the expression
+ * @param int order[] - set to the laws, in order
+ * 
+ * @return void
+ */
+static void order_laws(struct Search *search, int steps, int order[])
+{
+  long priority[MAX_SCAN_LAWS];
+  for (int i = 0; i < search->n_laws; i++)
+  {
+    priority[i] = search->history[i];
+    if (search->infos[i]->kind == lawShrink)
+      priority[i] += MAX_HISTORY;
+    if (i == search->killers[steps])
+      priority[i] += 2 * MAX_HISTORY;
+    int j = i;
+    for (; j > 0 && priority[order[j - 1]] < priority[i]; j--)
+      order[j] = order[j - 1];
+    order[j] = i;
+  }
+}
+
+/**
+ * @brief Function to credit a law with leading to a derivation, for
+ * move ordering
+ * - derivations found higher up in the search count for more, as they
+ *   save more search
+ * 
+ * @param struct Search *search - the current search
+ * @param int i - the law
+ * @param int steps - the depth of the expression it was applied to
+ * @param int cur_depth - the current depth of that expression
+ * 
+ * @return void
+ */
+static void credit_law(struct Search *search, int i, int steps, int cur_depth)
+{
+  search->killers[steps] = i;
+  search->history[i] += (long)cur_depth * cur_depth;
+  if (search->history[i] > MAX_HISTORY)
+    for (int j = 0; j < search->n_laws; j++)
+      search->history[j] /= 2;
+}
+
+/**
+ * @brief Function to record a derivation in search->best
+ * 
+ * @param struct Search *search - the current search
+ * @param int steps - the number of steps of the derivation
+ * 
+ * @return void
+ */
+static void record_best(struct Search *search, int steps)
+{
+  if (search->best == -1 || steps < search->best)
+    search->best = steps;
+}
+
+/**
+ * @brief Function to give the horizon of a search from an expression:
+ * only derivations of fewer steps from it need to be found
+ * - these are the ones that apply would find from it
+ * - and those that are shorter than the best so far, in total
+ * 
+ * @param struct Search *search - the current search
+ * @param int cur_depth - the current depth
+ * 
+ * @return int - the horizon
+ */
+static int horizon_of(struct Search *search, int cur_depth)
+{
+  int steps = search->max_depth - cur_depth;
+  if (search->best != -1 && search->best - steps < cur_depth)
+    return search->best - steps;
+  return cur_depth;
+}
+
+/**
+ * @brief Function to find the laws with which one step turns an
+ * expression into T
+ * - that step must be at the root, as the root stays as it is otherwise
+ * - and the law must be one that makes expressions smaller (lawShrink),
+ *   as T is smaller than any other expression
+ * - so this is a lower bound on the steps of derivations: 0 from T,
+ *   1 if there are such laws, else 2; the size of an expression gives no
+ *   better one, as some laws (domination, complement) turn expressions
+ *   of any size into T in one step
+ * - the expression is rewritten in place for each law at the root and
+ *   the rewrite is undone; these rewrites only make a few nodes
+ * 
+ * @param struct Search *search - the current search, of which all laws
+ *   have infos
+ * @param struct Expr *expr_tree - the expression, which is not T
+ * 
+ * @return unsigned - the laws, a bit per law
+ */
+static unsigned laws_to_true(struct Search *search, struct Expr *expr_tree)
+{
+  int root[] = {0};
+  unsigned laws = 0;
+  for (int i = 0; i < search->n_laws; i++)
+  {
+    struct LawInfo *info = search->infos[i];
+    if (info->kind != lawShrink || !law_matches(info, expr_tree))
+      continue;
+    struct Expr *root_expr = expr_tree;
+    if (rewrite_at(&search->undo, &root_expr, root, info->rewrite)->tag == isTrue)
+      laws |= 1u << i;
+    undo_rewrite(&search->undo);
+  }
+  return laws;
+}
+
+/**
+ * @brief Same search as apply, recording derivations in search->best
+ * - skip expressions from which only derivations at least as long as
+ *   the best so far can be found
+ * - with search->bound, where only derivations of one step are left,
+ *   find them with laws_to_true instead of searching the children
+ * - look up and store results in the transposition table, if any;
+ *   results do not depend on the path to the expression, only on
+ *   its horizon
+ * - skip the positions that next_position skips
+ * - with search->in_place, each child is made by rewriting the
+ *   expression in place, and the rewrite is undone after it
+ * - with search->ordering, laws are tried in order of order_laws; the
+ *   result does not depend on the order, but the search may find
+ *   short derivations sooner, and then prune more
+ * - stop as soon as the budget is exceeded
+ * 
+ * @param struct Search *search - the current search
+ * @param struct Expr *expr_tree - the current expression that needs applications
+ * @param int cur_depth - the current depth
+ * @param int *last - the position of the step to the expression, or NULL
+ * 
+ * @return int - the steps of the shortest derivation from the expression
+ * of fewer steps than its horizon, or -1 (also if the budget is exceeded);
+ * if next_position skips positions, of those that start with no step
+ * apart from and to the left of last
+ */
+static int search_from(struct Search *search, struct Expr *expr_tree, int cur_depth,
+                       int *last)
+{
+  if (cur_depth == 0) // when the max depth is exceeded
+    return -1;
+
+  int steps = search->max_depth - cur_depth;
+  if (expr_tree->tag == isTrue) // when the derivation is successful
+  {
+    record_best(search, steps);
+    return 0;
+  }
+
+  // a derivation through a child takes at least one more step
+  int horizon = horizon_of(search, cur_depth);
+  if (horizon <= 1)
+    return -1;
+  if (horizon == 2 && search->bound)
+  {
+    if (laws_to_true(search, expr_tree) == 0)
+      return -1;
+    record_best(search, steps + 1);
+    return 1;
+  }
+
+  unsigned long long hash = 0;
+  int res;
+  if (search->tt != NULL)
+  {
+    hash = hash_expr(expr_tree) ^ search->tt_salt;
+    if (tt_probe(search->tt, hash, horizon_of(search, cur_depth), &res))
+    {
+      if (res != -1)
+        record_best(search, steps + res);
+      return res;
+    }
+  }
+
+  if (over_budget(search))
+    return -1;
+  search->states++;
+  search->work += (long)expr_tree->size * expr_tree->size + CLOCK_WORK / 256;
+
+  res = -1;
+  TRACE_BEGIN("depth", steps);
+  struct NodeArray *nodes = NULL;
+  if (search->scan)
+  {
+    nodes = &scan_levels[steps];
+    flatten_expr(expr_tree, nodes);
+    match_laws(nodes, search->infos, search->n_laws);
+  }
+  int order[MAX_SCAN_LAWS];
+  if (search->ordering)
+    order_laws(search, steps, order);
+  for (int j = 0; j < search->n_laws && !search->exceeded; j++)
+  {
+    int i = search->ordering ? order[j] : j;
+    TRACE_BEGIN("law", i);
+    int index = -1;
+    int *cur_path = next_position(search, nodes, i, expr_tree, NULL, &index, last);
+    while (cur_path != NULL)
+    {
+      TRACE_BEGIN("apply", -1);
+      struct Expr *cur_expr;
+      if (search->in_place)
+        cur_expr = rewrite_at(&search->undo, &expr_tree, cur_path, search->infos[i]->rewrite);
+      else
+        cur_expr = search->applies[i](expr_tree, cur_path);
+      TRACE_END("apply");
+      long bytes = bytes_of(cur_expr, steps);
+      search->work += cur_expr->size;
+      search->bytes += bytes;
+      int child_res = search_from(search, cur_expr, cur_depth - 1, cur_path);
+      if (child_res != -1 && (res == -1 || child_res + 1 < res))
+      {
+        res = child_res + 1;
+        if (search->ordering)
+          credit_law(search, i, steps, cur_depth);
+      }
+      search->bytes -= bytes;
+      if (search->in_place) // puts back expr_tree, as it was
+        undo_rewrite(&search->undo);
+      else
+        free_expr(cur_expr);
+
+      int *next_path = over_budget(search) ? NULL :
+                       next_position(search, nodes, i, expr_tree, cur_path, &index, last);
+      free_path(cur_path);
+      cur_path = next_path;
+    }
+    TRACE_END("law");
+  }
+  TRACE_END("depth");
+
+  // children were searched with the horizon as it is now
+  if (search->tt != NULL && !search->exceeded)
+    tt_store(search->tt, hash, horizon_of(search, cur_depth), res);
+  return res;
+}
+
+/**
+ * @brief Function to find the shortest derivation with bfs_derivation,
+ * with the files in search->bfs_dir, or the filter of search->bfs_filter,
+ * and the limits of search->budget
+ * - the bytes of the budget are the memory of a run, or of the levels
+ *   in memory
+ * - search->exceeded is set if a limit was reached or a file could not
+ *   be made
+ * - search->approximate is set if the filter may have cut derivations
+ * 
+ * @param struct Search *search - the search, for its budget and states
+ * @param struct Expr *expr_tree - the expression
+ * @param int max_depth - the max depth and the threshold
+ * @param LawSearch searches[] - the array contains all searching methods
+ * @param LawApplication applies[] - the array contains all applying methods
+ * @param int n_laws - the total number of laws
+ * 
+ * @return int - the number of steps of the shortest derivation, or -1
+ */
+static int bfs_with_budget(struct Search *search, struct Expr *expr_tree, int max_depth,
+                           LawSearch searches[], LawApplication applies[], int n_laws)
+{
+  struct BfsOptions options = {
+      .dir = search->bfs_dir,
+      .memory = search->budget.max_bytes > 0 ? search->budget.max_bytes : BFS_MEMORY,
+      .max_states = search->budget.max_states,
+      .max_millis = search->budget.max_millis,
+      .filter_bytes = search->bfs_filter,
+  };
+  struct BfsStats stats;
+  int res = bfs_derivation(expr_tree, max_depth, searches, applies, n_laws, &options, &stats);
+  search->states += stats.states;
+  if (stats.exceeded)
+    search->exceeded = true;
+  if (stats.approximate)
+    search->approximate = true;
+  return res;
+}
+
+/**
+ * @brief Function to find the shortest derivation within the budget
+ * - with search->prefilter, first check with a BDD whether the expression
+ *   is a tautology: the laws keep expressions equivalent, so there is no
+ *   derivation of T from one that is not
+ * - start with the derivation of the greedy normalizer, if any, so that
+ *   only shorter ones need to be searched
+ * - the result is the same as of apply, unless the budget is exceeded
+ * - then search->exceeded is set and the result is the shortest
+ *   derivation found so far (an upper bound), or -1
+ * - with search->in_place, the expression is rewritten during the
+ *   search, but it is as it was afterwards
+ * 
+ * @param struct Search *search - the search, prepared by init_search
+ * @param struct Expr *expr_tree - the expression
+ * 
+ * @return int - the number of steps of the shortest derivation, or -1
+ */
+int search_derivation(struct Search *search, struct Expr *expr_tree)
+{
+  search->states = 0;
+  search->work = CLOCK_WORK; // the clock is read at the first state
+  search->bytes = bytes_of(expr_tree, 0);
+  search->exceeded = false;
+  search->approximate = false;
+  search->best = -1;
+  if (search->prefilter && bdd_tautology(expr_tree, PREFILTER_NODES) == 0)
+    return search->best;
+  if (search->bfs_dir != NULL || search->bfs_filter > 0)
+    return search->best = bfs_with_budget(search, expr_tree, search->max_depth,
+                                          search->searches, search->applies, search->n_laws);
+  if (search->greedy) // derivations of max_depth steps are not found by apply
+    search->best = greedy_derivation(expr_tree, search->max_depth - 1, search->searches,
+                                     search->applies, search->n_laws);
+  clock_gettime(CLOCK_MONOTONIC, &search->start);
+  search_from(search, expr_tree, search->max_depth, NULL);
+  free_undo_log(&search->undo);
+  return search->best;
+}
+
+/**
+ * @brief Function to prepare a search with several law sets at once
+ * - the laws are those of the first law set, then those of the others
+ *   that are not in it, in order
+ * - laws with the same search function are the same, as it is paired
+ *   with the same application in all law sets
+ * 
+ * @param struct NestedSearch *nested - the search to prepare
+ * @param struct LawSet *sets[] - the law sets
+ * @param int n_sets - the number of law sets
+ * 
+ * @return bool - whether the law sets can be searched at once, which
+ *   needs at most MAX_NESTED_SETS law sets with MAX_SCAN_LAWS laws in all
+ */
+bool init_nested_search(struct NestedSearch *nested, struct LawSet *sets[], int n_sets)
+{
+  memset(nested, 0, sizeof(struct NestedSearch));
+  if (n_sets > MAX_NESTED_SETS)
+    return false;
+  int n_laws = 0;
+  int max_depth = 0;
+  for (int k = 0; k < n_sets; k++)
+  {
+    nested->sets[k] = sets[k];
+    if (sets[k]->max_depth > max_depth)
+      max_depth = sets[k]->max_depth;
+    for (int j = 0; j < sets[k]->n_laws; j++)
+    {
+      int i = 0;
+      while (i < n_laws && nested->searches[i] != sets[k]->searches[j])
+        i++;
+      if (i == n_laws)
+      {
+        if (n_laws == MAX_SCAN_LAWS)
+          return false;
+        nested->searches[i] = sets[k]->searches[j];
+        nested->applies[i] = sets[k]->applies[j];
+        n_laws++;
+      }
+      nested->masks[i] |= 1u << k;
+    }
+  }
+  nested->n_sets = n_sets;
+  init_search(&nested->search, max_depth, nested->searches, nested->applies, n_laws);
+  return true;
+}
+
+/**
+ * @brief Function to give the horizon of a search from an expression,
+ * as horizon_of, for one law set of a nested search
+ * 
+ * @param struct NestedSearch *nested - the current search
+ * @param int k - the law set
+ * @param int steps - the number of steps to the expression
+ * 
+ * @return int - the horizon
+ */
+static int nested_horizon_of(struct NestedSearch *nested, int k, int steps)
+{
+  int cur_depth = nested->sets[k]->max_depth - steps;
+  int best = nested->bests[k];
+  if (best != -1 && best - steps < cur_depth)
+    return best - steps;
+  return cur_depth;
+}
+
+/**
+ * @brief Function to give the salt of the hashes of a law set of
+ * a nested search in the transposition table
+ * 
+ * @param int k - the law set
+ * 
+ * @return unsigned long long - the salt
+ */
+static unsigned long long nested_salt(int k)
+{
+  return (k + 1) * 0x9e3779b97f4a7c15ULL;
+}
+
+/**
+ * @brief Same search as search_from, for the law sets in mask at once
+ * - all steps to the expression are in all law sets in mask
+ * - a law set is left out where search_from would stop for it: past its
+ *   max depth, at T, within the horizon of its best derivation, where
+ *   only derivations of one step are left, or when its result is in the
+ *   transposition table
+ * - the children made by a law are searched for the law sets in mask
+ *   that have the law
+ * - the positions that next_position skips are skipped for all law
+ *   sets, as a derivation reordered by it has the same laws
+ * 
+ * @param struct NestedSearch *nested - the current search
+ * @param struct Expr *expr_tree - the current expression that needs applications
+ * @param int steps - the number of steps to the expression
+ * @param unsigned mask - the law sets
+ * @param int *last - the position of the step to the expression, or NULL
+ * @param int res[] - set, for each law set in mask, to the steps of the
+ *   shortest derivation from the expression of fewer steps than its
+ *   horizon, or -1 (also if the budget is exceeded)
+ * 
+ * @return void
+ */
+static void search_nested_from(struct NestedSearch *nested, struct Expr *expr_tree,
+                               int steps, unsigned mask, int *last, int res[])
+{
+  struct Search *search = &nested->search;
+  unsigned long long hash = 0;
+  if (search->tt != NULL && expr_tree->tag != isTrue)
+    hash = hash_expr(expr_tree);
+  unsigned to_true = 0;  // law sets with a law of laws_to_true
+  bool found_to_true = false;
+  for (int k = 0; k < nested->n_sets; k++)
+  {
+    if (!(mask & 1u << k))
+      continue;
+    res[k] = -1;
+    int horizon = nested_horizon_of(nested, k, steps);
+    if (nested->sets[k]->max_depth - steps == 0) // when the max depth is exceeded
+      mask &= ~(1u << k);
+    else if (expr_tree->tag == isTrue) // when the derivation is successful
+    {
+      if (nested->bests[k] == -1 || steps < nested->bests[k])
+        nested->bests[k] = steps;
+      res[k] = 0;
+      mask &= ~(1u << k);
+    }
+    else if (horizon == 2 && search->bound)
+    {
+      if (!found_to_true)
+      {
+        unsigned laws = laws_to_true(search, expr_tree);
+        for (int i = 0; i < search->n_laws; i++)
+          if (laws & 1u << i)
+            to_true |= nested->masks[i];
+        found_to_true = true;
+      }
+      if (to_true & 1u << k)
+      {
+        res[k] = 1;
+        if (nested->bests[k] == -1 || steps + 1 < nested->bests[k])
+          nested->bests[k] = steps + 1;
+      }
+      mask &= ~(1u << k);
+    }
+    else if (horizon <= 1 ||
+             (search->tt != NULL && tt_probe(search->tt, hash ^ nested_salt(k), horizon, &res[k])))
+    {
+      if (res[k] != -1 && (nested->bests[k] == -1 || steps + res[k] < nested->bests[k]))
+        nested->bests[k] = steps + res[k];
+      mask &= ~(1u << k);
+    }
+  }
+  if (mask == 0 || over_budget(search))
+    return;
+  search->states++;
+  search->work += (long)expr_tree->size * expr_tree->size + CLOCK_WORK / 256;
+
+  TRACE_BEGIN("depth", steps);
+  struct NodeArray *nodes = NULL;
+  if (search->scan)
+  {
+    nodes = &scan_levels[steps];
+    flatten_expr(expr_tree, nodes);
+    match_laws(nodes, search->infos, search->n_laws);
+  }
+  int order[MAX_SCAN_LAWS];
+  if (search->ordering)
+    order_laws(search, steps, order);
+  for (int j = 0; j < search->n_laws && !search->exceeded; j++)
+  {
+    int i = search->ordering ? order[j] : j;
+    unsigned law_mask = mask & nested->masks[i];
+    if (law_mask == 0)
+      continue;
+    TRACE_BEGIN("law", i);
+    int index = -1;
+    int *cur_path = next_position(search, nodes, i, expr_tree, NULL, &index, last);
+    while (cur_path != NULL)
+    {
+      TRACE_BEGIN("apply", -1);
+      struct Expr *cur_expr;
+      if (search->in_place)
+        cur_expr = rewrite_at(&search->undo, &expr_tree, cur_path, search->infos[i]->rewrite);
+      else
+        cur_expr = search->applies[i](expr_tree, cur_path);
+      TRACE_END("apply");
+      long bytes = bytes_of(cur_expr, steps);
+      search->work += cur_expr->size;
+      search->bytes += bytes;
+      int child_res[MAX_NESTED_SETS];
+      search_nested_from(nested, cur_expr, steps + 1, law_mask, cur_path, child_res);
+      for (int k = 0; k < nested->n_sets; k++)
+        if ((law_mask & 1u << k) && child_res[k] != -1 &&
+            (res[k] == -1 || child_res[k] + 1 < res[k]))
+        {
+          res[k] = child_res[k] + 1;
+          if (search->ordering)
+            credit_law(search, i, steps, nested->sets[k]->max_depth - steps);
+        }
+      search->bytes -= bytes;
+      if (search->in_place)
+        undo_rewrite(&search->undo);
+      else
+        free_expr(cur_expr);
+
+      int *next_path = over_budget(search) ? NULL :
+                       next_position(search, nodes, i, expr_tree, cur_path, &index, last);
+      free_path(cur_path);
+      cur_path = next_path;
+    }
+    TRACE_END("law");
+  }
+  TRACE_END("depth");
+
+  if (search->tt != NULL && !search->exceeded)
+    for (int k = 0; k < nested->n_sets; k++)
+      if (mask & 1u << k)
+        tt_store(search->tt, hash ^ nested_salt(k), nested_horizon_of(nested, k, steps), res[k]);
+}
+
+/**
+ * @brief Function to find the shortest derivations with the law sets
+ * in mask, as search_derivation does for each of them
+ * - the budget is for all law sets together
+ * - the check for a tautology is done once for all law sets
+ * - with a breadth-first search on disk, each law set is searched on
+ *   its own, with the whole budget
+ * 
+ * @param struct NestedSearch *nested - the search, prepared by init_nested_search
+ * @param struct Expr *expr_tree - the expression
+ * @param unsigned mask - the law sets
+ * 
+ * @return void - the results are in nested->bests
+ */
+void search_nested_derivations(struct NestedSearch *nested, struct Expr *expr_tree,
+                               unsigned mask)
+{
+  struct Search *search = &nested->search;
+  search->states = 0;
+  search->work = CLOCK_WORK; // the clock is read at the first state
+  search->bytes = bytes_of(expr_tree, 0);
+  search->exceeded = false;
+  search->approximate = false;
+  for (int k = 0; k < nested->n_sets; k++)
+    nested->bests[k] = -1;
+  if (search->prefilter && bdd_tautology(expr_tree, PREFILTER_NODES) == 0)
+    return;
+  bool bfs = search->bfs_dir != NULL || search->bfs_filter > 0;
+  for (int k = 0; k < nested->n_sets && bfs; k++)
+  {
+    struct LawSet *set = nested->sets[k];
+    if (mask & 1u << k)
+      nested->bests[k] = bfs_with_budget(search, expr_tree, set->max_depth, set->searches,
+                                         set->applies, set->n_laws);
+  }
+  if (bfs)
+    return;
+  for (int k = 0; k < nested->n_sets; k++)
+  {
+    struct LawSet *set = nested->sets[k];
+    if (search->greedy && (mask & 1u << k))
+      nested->bests[k] = greedy_derivation(expr_tree, set->max_depth - 1, set->searches,
+                                           set->applies, set->n_laws);
+  }
+  clock_gettime(CLOCK_MONOTONIC, &search->start);
+  int res[MAX_NESTED_SETS];
+  search_nested_from(nested, expr_tree, 0, mask, NULL, res);
+  free_undo_log(&search->undo);
+}
+
+/**
+ * @brief Same as find_derivations_for_strings, for several law sets at once
+ * - look up results in the answer table and the memo, as derivation_with_memo
+ * - print the results of the law sets on one line, in order
+ * - the line starts with "exceeded" if the budget was exceeded, or with
+ *   "approximate" if a filter may have cut derivations, and then
+ *   the results searched for are only upper bounds
+ * 
+ * @param struct LawSet *sets[] - the law sets
+ * @param int n_sets - the number of law sets
+ * 
+ * @return void
+ */
+void find_nested_derivations_for_strings(struct LawSet *sets[], int n_sets)
+{
+  struct NestedSearch nested;
+  if (!init_nested_search(&nested, sets, n_sets))
+  {
+    fprintf(stderr, "Too many law sets or laws to search at once\n");
+    return;
+  }
+  if (run_options.tt_slots > 0)
+    nested.search.tt = tt_new(run_options.tt_slots);
+  struct ResultCache *memo = cache_new(MEMO_ENTRIES);
+  char *line = NULL;
+  size_t len = 0;
+  int line_number = 0;
+  int n_files = 0;
+  while (next_input(&line, &len, &n_files))
+  {
+    int size = strlen(line);
+    if (size >= 1 && line[size - 1] == '\n')
+      line[size - 1] = '\0';
+
+    struct MemStats start;
+    if (mem_accounting)
+      mem_query_begin(&start);
+    line_number++;
+    TRACE_BEGIN("line", line_number);
+    struct Expr *expr_tree = read_input(line);
+    if (expr_tree == NULL) // reported by read_input
+      printf("error\n");
+    else
+    {
+      // results in the memo are keyed by law set and expression
+      normalize_vars(expr_tree);
+      size_t code_len;
+      unsigned char *code = serial_encode_expr(expr_tree, &code_len);
+      unsigned char *key = malloc(code_len + 1);
+      memcpy(key + 1, code, code_len);
+      int res[MAX_NESTED_SETS];
+      unsigned mask = 0;
+      for (int k = 0; k < n_sets; k++)
+      {
+        key[0] = (unsigned char)k;
+        if (answer_table != NULL &&
+            table_lookup(answer_table, table_column(answer_table, sets[k]->searches,
+                                                    sets[k]->max_depth),
+                         expr_tree, &res[k]))
+          continue;
+        if (!cache_get(memo, key, code_len + 1, &res[k]))
+          mask |= 1u << k;
+      }
+      nested.search.exceeded = false;
+      nested.search.approximate = false;
+      if (mask != 0)
+      {
+        search_nested_derivations(&nested, expr_tree, mask);
+        for (int k = 0; k < n_sets; k++)
+        {
+          if (!(mask & 1u << k))
+            continue;
+          res[k] = nested.bests[k];
+          key[0] = (unsigned char)k;
+          if (!nested.search.exceeded && !nested.search.approximate)
+            cache_put(memo, key, code_len + 1, res[k]);
+        }
+      }
+      if (nested.search.exceeded)
+        printf("exceeded ");
+      else if (nested.search.approximate)
+        printf("approximate ");
+      for (int k = 0; k < n_sets; k++)
+        printf(k == 0 ? "%d" : " %d", res[k]);
+      printf("\n");
+      free(key);
+      free(code);
+      free_expr(expr_tree);
+    }
+    TRACE_END("line");
+    if (mem_accounting)
+      report_memory(line_number, &start);
+  }
+  free(line);
+  cache_free(memo);
+  if (nested.search.tt != NULL)
+    tt_free(nested.search.tt);
+  write_profile(&nested.search);
+  write_trace();
+}
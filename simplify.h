@@ -1,10 +1,118 @@
 #ifndef SIMPLIFY_H
 #define SIMPLIFY_H
 
+#include <stdbool.h>
+#include <time.h>
+
 #include "laws.h"
+#include "scan.h"
+#include "table.h"
+#include "tt.h"
+
+/* Limits on the search for one expression. Zero means no limit.
+ */
+struct Budget {
+	long max_states; // expressions expanded
+	long max_bytes;  // held by the expressions on the current search path
+	long max_millis; // wall-clock time
+};
+
+/* Options of a run, from the command line.
+ */
+struct Options {
+	bool binary;    // read and write LEXB streams
+	bool no_greedy; // do not start the search with a greedy upper bound
+	struct Budget budget;
+	char *trace_prefix; // write a trace of the search to files with this prefix, or NULL
+	long tt_slots;      // size of the transposition table, 0 for none
+	bool in_place;      // rewrite one working tree in place, with an undo log
+	bool fixed_order;   // try laws in table order, without move ordering
+	bool no_reduction;  // search all orders of rewrites apart from each other
+	bool no_prefilter;  // do not check for a tautology with a BDD before searching
+	char *bfs_dir;      // search breadth first with the levels in files in this directory, or NULL
+	long bfs_filter;    // or in memory, with a filter of this many bytes for earlier levels, or 0
+	char *profile;      // read the weights of laws for move ordering from this file, or NULL
+	char *profile_out;  // write the weights after the run to this file, or NULL
+	char *table;        // look up small expressions in this answer table, or NULL
+	char **dimacs_files; // read the inputs from these DIMACS files instead of standard input
+	int n_dimacs_files;
+};
+
+extern struct Options run_options;
+
+/* Most laws in a law set for which the positions are found with
+ * a node array (see scan.h), or which are rewritten in place.
+ */
+#define MAX_SCAN_LAWS 32
+
+/* State of the search for one expression.
+ */
+struct Search {
+	LawSearch *searches;
+	LawApplication *applies;
+	int n_laws;
+	int max_depth;
+	bool scan;     // find positions with node arrays, as all laws have infos
+	bool bound;    // cut searches with laws_to_true, as all laws have infos
+	bool in_place; // rewrite in place, with the rewrites of the infos
+	struct LawInfo *infos[MAX_SCAN_LAWS];
+	struct UndoLog undo;
+	bool ordering;               // try laws in order of the heuristics below
+	long history[MAX_SCAN_LAWS]; // weight of the derivations each law led to
+	int killers[256];            // by steps: law that last led to one, or -1
+	bool reduce; // without tt, rewrites apart from each other are only done left to right
+	bool greedy;    // start from the bound found by greedy_derivation
+	bool prefilter; // answer -1 without searching if bdd_tautology says no
+	char *bfs_dir;  // search with bfs_derivation instead, with files here, or NULL
+	long bfs_filter; // or in memory, with a filter of this many bytes, or 0
+	struct Budget budget;
+	long states;
+	long work;  // since the clock was last read, see over_budget
+	long bytes;
+	struct timespec start;
+	bool exceeded; // the budget was exceeded, so best is only an upper bound
+	bool approximate; // the filter of bfs_filter may have cut derivations, so best is too
+	int best;      // steps of shortest derivation found so far, or -1
+	struct TransTable *tt;      // may be shared with other searches, or NULL
+	unsigned long long tt_salt; // mixed into hashes, to tell law sets apart
+	struct AnswerTable *table;  // of run_options.table, if it has the law set, or NULL
+	int table_column;
+};
+
+/* Most law sets searched at once.
+ */
+#define MAX_NESTED_SETS 8
+
+/* State of the search for one expression with several law sets at once,
+ * over the union of their laws. Each law has a mask of the law sets
+ * that have it. A derivation counts for the law sets that have all of
+ * its laws, so an expression reached by steps that several law sets
+ * have is searched from once for all of them.
+ */
+struct NestedSearch {
+	struct Search search; // over the union; its best is not used
+	int n_sets;
+	struct LawSet *sets[MAX_NESTED_SETS];
+	LawSearch searches[MAX_SCAN_LAWS];
+	LawApplication applies[MAX_SCAN_LAWS];
+	unsigned masks[MAX_SCAN_LAWS];
+	int bests[MAX_NESTED_SETS]; // as search.best, by law set
+};
+
+bool parse_size(char *str, long *size);
+bool parse_options(int argc, char **argv);
+void init_search(struct Search *search, int max_depth,
+		LawSearch searches[], LawApplication applies[], int n_laws);
+int search_derivation(struct Search *search, struct Expr *expr_tree);
 
 void find_derivations_for_strings(int max_depth,
 		LawSearch searches[], LawApplication applies[], char* names[], int n_laws);
+void find_derivations_for_binary(int max_depth,
+		LawSearch searches[], LawApplication applies[], int n_laws);
+bool init_nested_search(struct NestedSearch *nested, struct LawSet *sets[], int n_sets);
+void search_nested_derivations(struct NestedSearch *nested, struct Expr *expr_tree,
+		unsigned mask);
+void find_nested_derivations_for_strings(struct LawSet *sets[], int n_sets);
 int min_deri(int size, int *deri, int max_depth);
 int apply(struct Expr *expr_tree, int cur_depth, int max_depth, LawSearch searches[],
           LawApplication applies[], int n_laws);
@@ -0,0 +1,325 @@
+#include <fcntl.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "table.h"
+
+/*******************************************/
+/* Ranks.                                  */
+/*******************************************/
+
+/* Symbols of nodes in prefix order, in the order of ranks:
+ * variable j is symbol VAR + j.
+ */
+enum {DISJ, CONJ, NEG, TRUE, FALSE, VAR};
+
+/* Numbers of ways to finish an expression, indexed by the number of
+ * nodes r still to come, the number of subexpressions s still to start
+ * (the open slots), and the number of variables v so far.
+ */
+struct Counts {
+	int max_nodes;
+	long *counts;
+};
+
+static long *count_at(struct Counts *counts, int r, int s, int v) {
+	int n = counts->max_nodes + 2;
+	return &counts->counts[(r * n + s) * n + v];
+}
+
+static long count_of(struct Counts *counts, int r, int s, int v) {
+	if (s > r) // each slot takes a node
+		return 0;
+	return *count_at(counts, r, s, v);
+}
+
+/* Open slots and variables after symbol, if there were s and v before.
+ */
+static void after(int symbol, int *s, int *v) {
+	if (symbol == DISJ || symbol == CONJ)
+		(*s)++;
+	else if (symbol != NEG)
+		(*s)--;
+	if (symbol == VAR + *v)
+		(*v)++;
+}
+
+/* Counts for max_nodes. They are kept per thread, for the last max_nodes.
+ */
+static struct Counts *counts_for(int max_nodes) {
+	static __thread struct Counts counts;
+	if (counts.counts != NULL && counts.max_nodes == max_nodes)
+		return &counts;
+	free(counts.counts);
+	int n = max_nodes + 2;
+	counts.max_nodes = max_nodes;
+	counts.counts = calloc((max_nodes + 1) * n * n, sizeof(long));
+	for (int v = 0; v < n; v++)
+		*count_at(&counts, 0, 0, v) = 1;
+	for (int r = 1; r <= max_nodes; r++)
+		for (int s = 1; s <= r; s++)
+			for (int v = 0; v <= max_nodes; v++) {
+				long count = 0;
+				for (int symbol = DISJ; symbol <= VAR + v; symbol++) {
+					int s1 = s, v1 = v;
+					after(symbol, &s1, &v1);
+					count += count_of(&counts, r - 1, s1, v1);
+				}
+				*count_at(&counts, r, s, v) = count;
+			}
+	return &counts;
+}
+
+/* Number of expressions with up to max_nodes nodes, which have a rank.
+ */
+long table_size(int max_nodes) {
+	if (max_nodes < 1 || max_nodes > MAX_TABLE_NODES)
+		return 0;
+	struct Counts *counts = counts_for(max_nodes);
+	long size = 0;
+	for (int n = 1; n <= max_nodes; n++)
+		size += count_of(counts, n, 1, 0);
+	return size;
+}
+
+static int symbol_of(struct Expr *expr) {
+	switch (expr->tag) {
+		case isDisj:
+			return DISJ;
+		case isConj:
+			return CONJ;
+		case isNeg:
+			return NEG;
+		case isTrue:
+			return TRUE;
+		case isFalse:
+			return FALSE;
+		default:
+			return VAR + expr->var;
+	}
+}
+
+/* Add to *rank the expressions that come before expr, of which the
+ * nodes before it are the same, with r nodes from expr on, s open
+ * slots and v variables before it. Return false if the variables
+ * of expr are not in order of first occurrence.
+ */
+static bool rank_from(struct Counts *counts, struct Expr *expr, int *r, int *s, int *v,
+		long *rank) {
+	int symbol = symbol_of(expr);
+	if (symbol > VAR + *v)
+		return false;
+	for (int before = DISJ; before < symbol; before++) {
+		int s1 = *s, v1 = *v;
+		after(before, &s1, &v1);
+		*rank += count_of(counts, *r - 1, s1, v1);
+	}
+	after(symbol, s, v);
+	(*r)--;
+	if (symbol == DISJ || symbol == CONJ || symbol == NEG)
+		if (!rank_from(counts, expr->expr1, r, s, v, rank))
+			return false;
+	if (symbol == DISJ || symbol == CONJ)
+		if (!rank_from(counts, expr->expr2, r, s, v, rank))
+			return false;
+	return true;
+}
+
+/* Rank of expression, or -1 if it has none.
+ */
+long table_rank(struct Expr *expr, int max_nodes) {
+	int size = size_expr(expr);
+	if (size > max_nodes || max_nodes < 1 || max_nodes > MAX_TABLE_NODES)
+		return -1;
+	struct Counts *counts = counts_for(max_nodes);
+	long rank = 0;
+	for (int n = 1; n < size; n++)
+		rank += count_of(counts, n, 1, 0);
+	int r = size, s = 1, v = 0;
+	return rank_from(counts, expr, &r, &s, &v, &rank) ? rank : -1;
+}
+
+/* Expression made of symbols from *next on.
+ */
+static struct Expr *make_from(int **next) {
+	int symbol = *(*next)++;
+	switch (symbol) {
+		case DISJ: {
+			struct Expr *expr1 = make_from(next);
+			return make_disj(expr1, make_from(next));
+		}
+		case CONJ: {
+			struct Expr *expr1 = make_from(next);
+			return make_conj(expr1, make_from(next));
+		}
+		case NEG:
+			return make_neg(make_from(next));
+		case TRUE:
+			return make_true();
+		case FALSE:
+			return make_false();
+		default:
+			return make_var(symbol - VAR);
+	}
+}
+
+/* Expression with rank, or NULL if there is none.
+ */
+struct Expr *table_unrank(long rank, int max_nodes) {
+	if (rank < 0 || max_nodes < 1 || max_nodes > MAX_TABLE_NODES)
+		return NULL;
+	struct Counts *counts = counts_for(max_nodes);
+	int size = 1;
+	while (size <= max_nodes && rank >= count_of(counts, size, 1, 0)) {
+		rank -= count_of(counts, size, 1, 0);
+		size++;
+	}
+	if (size > max_nodes)
+		return NULL;
+	int symbols[size];
+	int s = 1, v = 0;
+	for (int i = 0, r = size; r > 0; i++, r--) {
+		int symbol = DISJ;
+		while (true) {
+			int s1 = s, v1 = v;
+			after(symbol, &s1, &v1);
+			long count = count_of(counts, r - 1, s1, v1);
+			if (rank < count)
+				break;
+			rank -= count;
+			symbol++;
+		}
+		symbols[i] = symbol;
+		after(symbol, &s, &v);
+	}
+	int *next = symbols;
+	return make_from(&next);
+}
+
+/*******************************************/
+/* Files.                                  */
+/*******************************************/
+
+#define TABLE_MAGIC "LXAT"
+#define TABLE_VERSION 1
+
+struct TableHeader {
+	char magic[4];
+	uint32_t version;
+	uint32_t max_nodes;
+	uint32_t n_sets;
+	struct {
+		char name[16];
+		uint32_t max_depth;
+	} sets[MAX_TABLE_SETS];
+	uint64_t n_entries;
+};
+
+struct AnswerTable {
+	void *map;
+	size_t len;
+	struct TableHeader *header;
+	unsigned char *results;
+};
+
+/* Write table with the results of all expressions up to max_nodes nodes,
+ * n_sets per expression in order of rank. Return whether it could be
+ * written.
+ */
+bool table_write(char *file_name, int max_nodes, struct LawSet *sets[], int n_sets,
+		unsigned char *results) {
+	if (n_sets > MAX_TABLE_SETS)
+		return false;
+	struct TableHeader header;
+	memset(&header, 0, sizeof(header));
+	memcpy(header.magic, TABLE_MAGIC, 4);
+	header.version = TABLE_VERSION;
+	header.max_nodes = max_nodes;
+	header.n_sets = n_sets;
+	for (int k = 0; k < n_sets; k++) {
+		if (strlen(sets[k]->name) >= sizeof(header.sets[k].name))
+			return false;
+		strcpy(header.sets[k].name, sets[k]->name);
+		header.sets[k].max_depth = sets[k]->max_depth;
+	}
+	header.n_entries = table_size(max_nodes);
+	FILE *file = fopen(file_name, "wb");
+	if (file == NULL)
+		return false;
+	bool ok = fwrite(&header, sizeof(header), 1, file) == 1 &&
+		fwrite(results, n_sets, header.n_entries, file) == header.n_entries;
+	return fclose(file) == 0 && ok;
+}
+
+/* Map table in file into memory. Return NULL (and print why) if it
+ * cannot be read or is not a table.
+ */
+struct AnswerTable *table_open(char *file_name) {
+	int fd = open(file_name, O_RDONLY);
+	if (fd == -1) {
+		perror(file_name);
+		return NULL;
+	}
+	struct stat st;
+	void *map = MAP_FAILED;
+	if (fstat(fd, &st) == 0 && (size_t) st.st_size >= sizeof(struct TableHeader))
+		map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);
+	struct TableHeader *header = map;
+	if (map == MAP_FAILED || memcmp(header->magic, TABLE_MAGIC, 4) != 0 ||
+			header->version != TABLE_VERSION || header->n_sets > MAX_TABLE_SETS ||
+			header->max_nodes > MAX_TABLE_NODES ||
+			header->n_entries != (uint64_t) table_size(header->max_nodes) ||
+			(size_t) st.st_size != sizeof(struct TableHeader) +
+				header->n_entries * header->n_sets) {
+		fprintf(stderr, "%s: not an answer table\n", file_name);
+		if (map != MAP_FAILED)
+			munmap(map, st.st_size);
+		return NULL;
+	}
+	struct AnswerTable *table = malloc(sizeof(struct AnswerTable));
+	table->map = map;
+	table->len = st.st_size;
+	table->header = header;
+	table->results = (unsigned char *) map + sizeof(struct TableHeader);
+	return table;
+}
+
+/* Column of the table with the results for the law set with searches
+ * and max depth, or -1 if it has none.
+ */
+int table_column(struct AnswerTable *table, LawSearch searches[], int max_depth) {
+	for (uint32_t k = 0; k < table->header->n_sets; k++) {
+		char name[sizeof(table->header->sets[k].name) + 1] = {0};
+		memcpy(name, table->header->sets[k].name, sizeof(table->header->sets[k].name));
+		struct LawSet *set = find_law_set(name);
+		if (set != NULL && set->searches == searches &&
+				table->header->sets[k].max_depth == (uint32_t) max_depth)
+			return k;
+	}
+	return -1;
+}
+
+/* Look up result of expression, of which the variables are numbered in
+ * order of first occurrence, in column. Return whether it is in the table.
+ */
+bool table_lookup(struct AnswerTable *table, int column, struct Expr *expr, int *result) {
+	if (column < 0)
+		return false;
+	long rank = table_rank(expr, table->header->max_nodes);
+	if (rank == -1)
+		return false;
+	unsigned char res = table->results[rank * table->header->n_sets + column];
+	*result = res == 0xff ? -1 : res;
+	return true;
+}
+
+void table_close(struct AnswerTable *table) {
+	munmap(table->map, table->len);
+	free(table);
+}
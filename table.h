@@ -0,0 +1,38 @@
+#ifndef TABLE_H
+#define TABLE_H
+
+#include <stdbool.h>
+
+#include "laws.h"
+#include "logic.h"
+
+/* Table of the results of all expressions of up to max_nodes nodes, up
+ * to renaming of variables, for a number of law sets, each with its max
+ * depth. It is made offline by make_table, and mapped into memory when
+ * it is used.
+ *
+ * Expressions are numbered by rank: expressions with fewer nodes come
+ * first, and those with the same number of nodes are in order of their
+ * nodes in prefix order, where disjunction < conjunction < negation
+ * < T < F < variables. Only expressions of which the variables are
+ * numbered in order of first occurrence (as by normalize_vars) have a
+ * rank. The file is a header with the law sets, then a byte per
+ * expression and law set with the result (0xff for -1).
+ */
+#define MAX_TABLE_NODES 16
+#define MAX_TABLE_SETS 8
+
+struct AnswerTable;
+
+long table_size(int max_nodes);
+long table_rank(struct Expr *expr, int max_nodes);
+struct Expr *table_unrank(long rank, int max_nodes);
+
+bool table_write(char *file_name, int max_nodes, struct LawSet *sets[], int n_sets,
+		unsigned char *results);
+struct AnswerTable *table_open(char *file_name);
+int table_column(struct AnswerTable *table, LawSearch searches[], int max_depth);
+bool table_lookup(struct AnswerTable *table, int column, struct Expr *expr, int *result);
+void table_close(struct AnswerTable *table);
+
+#endif // TABLE_H
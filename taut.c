@@ -0,0 +1,85 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "bdd.h"
+#include "dimacs.h"
+#include "logic.h"
+
+/* Check with BDDs whether expressions are tautologies, or whether pairs
+ * of expressions are equivalent, without searching for derivations.
+ * Usage: taut [-n max nodes] [DIMACS file ...]
+ * Each line of the input is an expression, or two expressions separated
+ * by "==", with or without spaces around it. For each line, one of these
+ * lines is printed:
+ *   yes       the expression is a tautology, or the two are equivalent
+ *   no        it is not, or they are not
+ *   unknown   this takes more BDD nodes than max nodes (default 1M)
+ *   error     an expression cannot be read
+ * As the laws keep expressions equivalent, only the expressions answered
+ * by "yes" can have a derivation of T.
+ * If DIMACS files (see dimacs.h) are given, their formulas are checked
+ * instead of the lines of standard input, with one line printed for each.
+ */
+
+static void print_answer(int res) {
+	printf("%s\n", res == 1 ? "yes" : res == 0 ? "no" : res == -1 ? "unknown" : "error");
+}
+
+int main(int argc, char **argv) {
+	long max_nodes = 1L << 20;
+	int opt;
+	while ((opt = getopt(argc, argv, "n:")) != -1) {
+		if (opt == 'n')
+			max_nodes = atol(optarg);
+		else
+			optind = argc + 1;
+	}
+	if (optind > argc || max_nodes < 2) {
+		fprintf(stderr, "Usage: %s [-n max nodes] [DIMACS file ...]\n", argv[0]);
+		return 2;
+	}
+	if (optind < argc) {
+		for (int i = optind; i < argc; i++) {
+			struct Expr *expr = read_dimacs(argv[i]); // errors are reported by read_dimacs
+			print_answer(expr != NULL ? bdd_tautology(expr, max_nodes) : -2);
+			if (expr != NULL)
+				free_expr(expr);
+		}
+		return 0;
+	}
+
+	char *line = NULL;
+	size_t len = 0;
+	while (getline(&line, &len, stdin) != -1) {
+		int size = strlen(line);
+		if (size >= 1 && line[size - 1] == '\n')
+			line[size - 1] = '\0';
+		char *second = strstr(line, "==");
+		if (second != NULL) {
+			for (char *end = second; end > line && end[-1] == ' '; end--)
+				end[-1] = '\0';
+			*second = '\0';
+			second += 2;
+			while (*second == ' ')
+				second++;
+		}
+		struct Expr *expr1 = read_expr(line); // errors are reported by read_expr
+		struct Expr *expr2 = second != NULL && expr1 != NULL ? read_expr(second) : NULL;
+		int res;
+		if (expr1 == NULL || (second != NULL && expr2 == NULL))
+			res = -2;
+		else if (second != NULL)
+			res = bdd_equivalent(expr1, expr2, max_nodes);
+		else
+			res = bdd_tautology(expr1, max_nodes);
+		print_answer(res);
+		if (expr1 != NULL)
+			free_expr(expr1);
+		if (expr2 != NULL)
+			free_expr(expr2);
+	}
+	free(line);
+	return 0;
+}
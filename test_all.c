@@ -5,6 +5,16 @@
 #include "test_logic.h"
 #include "laws.h"
 #include "test_laws.h"
+#include "serial.h"
+#include "test_serial.h"
+#include "bdd.h"
+#include "test_bdd.h"
+#include "dimacs.h"
+#include "test_dimacs.h"
+#include "table.h"
+#include "test_table.h"
+#include "proof.h"
+#include "test_proof.h"
 
 /* Run a number of tests.
  */
@@ -12,7 +22,30 @@ int main(void) {
 	// logic
 	test_expr_io();
 	test_expr_copy();
+	test_normalize_vars();
+	test_expr_fields();
 	// laws
 	test_search();
 	test_apply();
+	test_scan();
+	test_rewrite();
+	test_subexpr_at();
+	test_law_matches();
+	// serial
+	test_serial_expr();
+	test_serial_stream();
+	test_serial_bad();
+	// bdd
+	test_bdd_tautology();
+	test_bdd_gc();
+	// dimacs
+	test_dimacs();
+	test_dimacs_balanced();
+	// table
+	test_table_size();
+	test_table_rank();
+	test_table_no_rank();
+	// proof
+	test_proofs();
+	test_proof_law_names();
 }
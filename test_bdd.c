@@ -0,0 +1,51 @@
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "bdd.h"
+#include "logic.h"
+#include "test_bdd.h"
+
+/* Test whether expression in string 'str' is a tautology, or whether
+ * it is equivalent to that in 'str2' if not NULL.
+ */
+static void test_bdd_str(char *str, char *str2, int expected) {
+	struct Expr *expr = read_expr(str);
+	struct Expr *expr2 = str2 != NULL ? read_expr(str2) : NULL;
+	int res = str2 != NULL ? bdd_equivalent(expr, expr2, 1 << 16) : bdd_tautology(expr, 1 << 16);
+	if (str2 != NULL)
+		printf("%s == %s: %d", str, str2, res);
+	else
+		printf("%s: %d", str, res);
+	printf(res == expected ? "\n" : " (NOT OK)\n");
+	free_expr(expr);
+	if (expr2 != NULL)
+		free_expr(expr2);
+}
+
+void test_bdd_tautology() {
+	test_bdd_str("T", NULL, 1);
+	test_bdd_str("F", NULL, 0);
+	test_bdd_str("a|-a", NULL, 1);
+	test_bdd_str("a&-a", NULL, 0);
+	test_bdd_str("-(a&b)|(a|-b)", NULL, 1);
+	test_bdd_str("(a|b)&(a|c)", "a|(b&c)", 1);
+	test_bdd_str("-(a|b)", "-a|-b", 0);
+	test_bdd_str("x1|x2", "x2|x1", 1);
+}
+
+/* Check equivalence in a manager that is too small to hold the garbage
+ * of all steps, so that bdd_of_expr has to collect it, and in one that
+ * is too small for the BDDs themselves.
+ */
+void test_bdd_gc() {
+	struct Expr *expr = read_expr("((a|b)&(c|d))&((e|f)&(g|h))");
+	struct Expr *expr2 = read_expr("((h|g)&(f|e))&((d|c)&(b|a))");
+	int res = bdd_equivalent(expr, expr2, 40);
+	printf("equivalence with collected garbage: %d", res);
+	printf(res == 1 ? "\n" : " (NOT OK)\n");
+	res = bdd_equivalent(expr, expr2, 4);
+	printf("equivalence in a manager that is too small: %d", res);
+	printf(res == -1 ? "\n" : " (NOT OK)\n");
+	free_expr(expr);
+	free_expr(expr2);
+}
@@ -0,0 +1,8 @@
+#ifndef TEST_BDD_H
+#define TEST_BDD_H
+
+void test_bdd_tautology();
+
+void test_bdd_gc();
+
+#endif // TEST_BDD_H
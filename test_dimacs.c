@@ -0,0 +1,73 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include "dimacs.h"
+#include "logic.h"
+#include "test_dimacs.h"
+
+/* Read the formula in DIMACS text 'text' through a file, or NULL.
+ */
+static struct Expr *read_dimacs_text(const char *text) {
+	char file_name[] = "/tmp/test_dimacsXXXXXX";
+	int fd = mkstemp(file_name);
+	FILE *file = fdopen(fd, "w");
+	fputs(text, file);
+	fclose(file);
+	struct Expr *expr = read_dimacs(file_name);
+	unlink(file_name);
+	return expr;
+}
+
+/* Test reading of DIMACS text, which should read as the expression in
+ * string 'expected', or not at all if it is NULL.
+ */
+static void test_dimacs_str(const char *text, char *expected) {
+	struct Expr *expr = read_dimacs_text(text);
+	struct Expr *expected_expr = expected != NULL ? read_expr(expected) : NULL;
+	if (expr != NULL) {
+		print_expr(expr);
+		printf("\n");
+	} else {
+		printf("cannot read\n");
+	}
+	if (expr != NULL && expected_expr != NULL ? !equal_expr(expr, expected_expr) :
+			expr != expected_expr)
+		printf("  expected %s (NOT OK)\n", expected != NULL ? expected : "an error");
+	if (expr != NULL)
+		free_expr(expr);
+	if (expected_expr != NULL)
+		free_expr(expected_expr);
+}
+
+void test_dimacs() {
+	test_dimacs_str("c two clauses\np cnf 3 2\n1 -2 0\n2 3\n -1 0\n", "(x1|-x2)&((x2|x3)|-x1)");
+	test_dimacs_str("p cnf 2 3\n1 0 -1 0 2 0\n%\n0\n", "(x1&-x1)&x2");
+	test_dimacs_str("p cnf 1 2\n1 0\n0\n", "x1&F");
+	test_dimacs_str("c nothing\np cnf 0 0\n", "T");
+	test_dimacs_str("p cnf 1000000000000 1\n1 -2000000 0\n", "x1|-x2000000");
+	test_dimacs_str("p cnf 2 1\n1 x 0\n", NULL);
+	test_dimacs_str("p cnf 2 1\n1 2\n", NULL);
+	test_dimacs_str("1 2 0\n", NULL);
+}
+
+/* Test that a long conjunction of long clauses is balanced.
+ */
+void test_dimacs_balanced() {
+	int n_clauses = 1000, n_literals = 100;
+	size_t cap = (size_t) n_clauses * n_literals * 6 + 64;
+	char *text = malloc(cap);
+	int len = sprintf(text, "p cnf %d %d\n", n_literals, n_clauses);
+	for (int i = 0; i < n_clauses; i++) {
+		for (int j = 1; j <= n_literals; j++)
+			len += sprintf(text + len, "%d ", (i + j) % 2 ? j : -j);
+		len += sprintf(text + len, "0\n");
+	}
+	struct Expr *expr = read_dimacs_text(text);
+	// 10 levels of conjunctions, 7 of disjunctions, a negation and a variable
+	printf("%d clauses of %d literals: %d nodes, height %d", n_clauses, n_literals,
+			expr->size, expr->height);
+	printf(expr->height <= 10 + 7 + 2 ? "\n" : " (NOT OK)\n");
+	free_expr(expr);
+	free(text);
+}
@@ -0,0 +1,8 @@
+#ifndef TEST_DIMACS_H
+#define TEST_DIMACS_H
+
+void test_dimacs();
+
+void test_dimacs_balanced();
+
+#endif // TEST_DIMACS_H
@@ -4,6 +4,7 @@
 
 #include "logic.h"
 #include "laws.h"
+#include "scan.h"
 #include "test_laws.h"
 
 /* In expression in string 'str', test finding all paths of occurrences of rewrite 
@@ -15,7 +16,7 @@ static void test_search_of(char *str, int law) {
 	int *path = non_path();
 	while (path != NULL) {
 		int *next_path = law_searches[law](expr, path);
-		free(path);
+		free_path(path);
 		path = next_path;
 		if (path != NULL) {
 			printf("    found at: ");
@@ -52,7 +53,7 @@ static void test_apply_of(char *str, int law) {
 	int *path = non_path();
 	while (path != NULL) {
 		int *next_path = law_searches[law](expr, path);
-		free(path);
+		free_path(path);
 		path = next_path;
 		if (path != NULL) {
 			printf("    found at: ");
@@ -71,3 +72,220 @@ void test_apply() {
 	test_apply_of("a|b|c", 0);
 	test_apply_of("a&b|-(a&b)", 12);
 }
+
+/* In expression in string 'str', test that the node array finds the same
+ * paths as the searches of the laws in law set, in the same order.
+ */
+static void test_scan_of(char *str, struct LawSet *set) {
+	struct Expr *expr = read_expr(str);
+	struct NodeArray array = {0};
+	struct LawInfo *infos[set->n_laws];
+	for (int law = 0; law < set->n_laws; law++)
+		infos[law] = law_info(set->searches[law]);
+	flatten_expr(expr, &array);
+	match_laws(&array, infos, set->n_laws);
+	int n_found = 0;
+	bool same = true;
+	for (int law = 0; law < set->n_laws; law++) {
+		int index = -1;
+		int *path = non_path();
+		while (path != NULL) {
+			int *next_path = set->searches[law](expr, path);
+			free_path(path);
+			path = next_path;
+			index = next_match(&array, infos[law], law, index + 1);
+			if ((path == NULL) != (index == -1)) {
+				same = false;
+			} else if (path != NULL) {
+				int *scan_path = path_to(&array, index);
+				for (int i = 0; path[i] > 0 || scan_path[i] > 0; i++)
+					if (path[i] != scan_path[i])
+						same = false;
+				free_path(scan_path);
+				n_found++;
+			}
+			if (!same) {
+				free_path(path);
+				path = NULL;
+			}
+		}
+	}
+	printf("%s\n  Law set: %s, kernel: %s\n    %d found, %s\n", str, set->name,
+			match_kernel(), n_found, same ? "same as search" : "DIFFERENT from search");
+	free_node_array(&array);
+	free_expr(expr);
+}
+
+void test_scan() {
+	char *strs[] = {
+		"a|(a&d|b)&(a&d|c)",
+		"--(a&b|-(a&b))|F&-F|(c|T)",
+		"(a|((b|c)|(d|e)))&(f&g|h&i)&(a|-a)&(a&a)|-(a|b)&-(c&d)|-F|(b&(b|c))|(b|b&c)"
+	};
+	for (size_t i = 0; i < sizeof(strs) / sizeof(char *); i++)
+		for (int set = 0; set < n_law_sets(); set++)
+			test_scan_of(strs[i], &law_sets[set]);
+}
+
+/* In expression in string 'str', test that rewriting in place at each
+ * position of each law of law set gives the same as applying the law,
+ * and that undoing it gives back the expression.
+ */
+static void test_rewrite_of(char *str, struct LawSet *set) {
+	struct Expr *expr = read_expr(str);
+	struct Expr *orig = copy_expr(expr);
+	struct UndoLog log = {0};
+	int n_found = 0;
+	bool same = true;
+	for (int law = 0; law < set->n_laws; law++) {
+		struct LawInfo *info = law_info(set->searches[law]);
+		int *path = non_path();
+		while (path != NULL) {
+			int *next_path = set->searches[law](expr, path);
+			free_path(path);
+			path = next_path;
+			if (path == NULL)
+				break;
+			struct Expr *applied = set->applies[law](expr, path);
+			struct Expr *root = expr;
+			struct Expr *rewritten = rewrite_at(&log, &root, path, info->rewrite);
+			if (!equal_expr(applied, rewritten) || applied->size != rewritten->size ||
+					applied->height != rewritten->height || applied->vars != rewritten->vars)
+				same = false;
+			undo_rewrite(&log);
+			if (root != expr || !equal_expr(expr, orig))
+				same = false;
+			free_expr(applied);
+			n_found++;
+		}
+	}
+	printf("%s\n  Law set: %s\n    %d rewritten, %s\n", str, set->name,
+			n_found, same ? "same as apply" : "DIFFERENT from apply");
+	free_undo_log(&log);
+	free_expr(orig);
+	free_expr(expr);
+}
+
+void test_rewrite() {
+	char *strs[] = {
+		"a|(a&d|b)&(a&d|c)",
+		"--(a&b|-(a&b))|F&-F|(c|T)",
+		"(a|((b|c)|(d|e)))&(f&g|h&i)&(a|-a)&(a&a)|-(a|b)&-(c&d)|-F|(b&(b|c))|(b|b&c)"
+	};
+	for (size_t i = 0; i < sizeof(strs) / sizeof(char *); i++)
+		for (int set = 0; set < n_law_sets(); set++)
+			test_rewrite_of(strs[i], &law_sets[set]);
+}
+
+/* In expression in string 'str', test the subexpression at path, which
+ * should be that in string 'expected', or none if it is NULL.
+ */
+static void test_subexpr_at_of(char *str, int *path, char *expected) {
+	struct Expr *expr = read_expr(str);
+	struct Expr *sub = subexpr_at(expr, path);
+	struct Expr *expected_expr = expected != NULL ? read_expr(expected) : NULL;
+	printf("%s at ", str);
+	for (int i = 0; path[i] != 0; i++)
+		printf("%d ", path[i]);
+	printf("0: ");
+	if (sub != NULL)
+		print_expr(sub);
+	else
+		printf("none");
+	if (sub != NULL && expected_expr != NULL ? !equal_expr(sub, expected_expr) :
+			sub != expected_expr)
+		printf(" (NOT OK)");
+	printf("\n");
+	if (expected_expr != NULL)
+		free_expr(expected_expr);
+	free_expr(expr);
+}
+
+void test_subexpr_at() {
+	test_subexpr_at_of("a|b&-c", (int[]) {0}, "a|b&-c");
+	test_subexpr_at_of("a|b&-c", (int[]) {2, 0}, "b&-c");
+	test_subexpr_at_of("a|b&-c", (int[]) {2, 2, 1, 0}, "c");
+	test_subexpr_at_of("a|b&-c", (int[]) {1, 0}, "a");
+	test_subexpr_at_of("a|b&-c", (int[]) {1, 1, 0}, NULL);
+	test_subexpr_at_of("a|b&-c", (int[]) {2, 2, 2, 0}, NULL);
+	test_subexpr_at_of("a|b&-c", (int[]) {2, 2, 1, 1, 0}, NULL);
+	test_subexpr_at_of("T", (int[]) {2, 0}, NULL);
+}
+
+/* Add to paths the paths of all subexpressions of expr, in prefix
+ * order, where prefix is the path to expr with depth steps.
+ */
+static void all_paths(struct Expr *expr, int *prefix, int depth, int **paths, int *n_paths) {
+	int *path = malloc((depth + 1) * sizeof(int));
+	for (int i = 0; i < depth; i++)
+		path[i] = prefix[i];
+	path[depth] = 0;
+	paths[(*n_paths)++] = path;
+	if (expr->tag == isDisj || expr->tag == isConj || expr->tag == isNeg) {
+		path[depth] = 1;
+		all_paths(expr->expr1, path, depth + 1, paths, n_paths);
+	}
+	if (expr->tag == isDisj || expr->tag == isConj) {
+		path[depth] = 2;
+		all_paths(expr->expr2, path, depth + 1, paths, n_paths);
+	}
+	path[depth] = 0;
+}
+
+static bool same_path(int *path1, int *path2) {
+	int i = 0;
+	while (path1[i] != 0 && path1[i] == path2[i])
+		i++;
+	return path1[i] == path2[i];
+}
+
+/* In expression in string 'str', test that each law of law set with an
+ * info matches exactly the subexpressions at the paths its search finds.
+ */
+static void test_law_matches_of(char *str, struct LawSet *set) {
+	struct Expr *expr = read_expr(str);
+	int size = size_expr(expr);
+	int *paths[size];
+	int n_paths = 0;
+	all_paths(expr, NULL, 0, paths, &n_paths);
+	int n_found = 0;
+	bool same = true;
+	for (int law = 0; law < set->n_laws; law++) {
+		struct LawInfo *info = law_info(set->searches[law]);
+		if (info == NULL)
+			continue;
+		bool found[size];
+		for (int i = 0; i < size; i++)
+			found[i] = false;
+		int *path = non_path();
+		while (path != NULL) {
+			int *next_path = set->searches[law](expr, path);
+			free_path(path);
+			path = next_path;
+			for (int i = 0; path != NULL && i < n_paths; i++)
+				if (same_path(path, paths[i]))
+					found[i] = true;
+		}
+		for (int i = 0; i < n_paths; i++) {
+			if (law_matches(info, subexpr_at(expr, paths[i])) != found[i])
+				same = false;
+			n_found += found[i];
+		}
+	}
+	printf("%s\n  Law set: %s\n    %d matched, %s\n", str, set->name,
+			n_found, same ? "same as search" : "DIFFERENT from search (NOT OK)");
+	for (int i = 0; i < n_paths; i++)
+		free(paths[i]);
+	free_expr(expr);
+}
+
+void test_law_matches() {
+	char *strs[] = {
+		"a|(a&d|b)&(a&d|c)",
+		"--(a&b|-(a&b))|F&-F|(c|T)",
+		"(a|((b|c)|(d|e)))&(f&g|h&i)&(a|-a)&(a&a)|-(a|b)&-(c&d)|-F|(b&(b|c))|(b|b&c)"
+	};
+	for (size_t i = 0; i < sizeof(strs) / sizeof(char *); i++)
+		for (int set = 0; set < n_law_sets(); set++)
+			test_law_matches_of(strs[i], &law_sets[set]);
+}
@@ -5,4 +5,12 @@ void test_search();
 
 void test_apply();
 
+void test_scan();
+
+void test_rewrite();
+
+void test_subexpr_at();
+
+void test_law_matches();
+
 #endif // TEST_LAWS_H
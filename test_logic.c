@@ -1,4 +1,6 @@
+#include <stdbool.h>
 #include <stdio.h>
+#include <string.h>
 
 #include "logic.h"
 #include "laws.h"
@@ -41,6 +43,7 @@ void test_expr_io() {
 	test_expr_io_str("(a|b)&(c|d)&(f|j|l)|a");
 	test_expr_io_str("(a&b)&(c&d)&(f&j&l)&a");
 	test_expr_io_str("-(a&b)&-(((c|d))&(f&j&l))&a");
+	test_expr_io_str("sig_clk|-(x1&x12)&Tx|F");
 }
 
 /* Test making copy of expression.
@@ -60,3 +63,97 @@ void test_expr_copy() {
 	free_expr(e1);
 	free_expr(e2);
 }
+
+/* Test renaming of variables in order of first occurrence.
+ */
+static void test_normalize_vars_str(char *str) {
+	struct Expr *expr = read_expr(str);
+	normalize_vars(expr);
+	printf("%s renamed: ", str);
+	print_expr(expr);
+	printf("\n");
+	free_expr(expr);
+}
+
+/* Test that the variables after z are not renamed to names that can be
+ * read, such as v26 in str.
+ */
+static void test_normalize_late_vars(char *str) {
+	struct Expr *expr = read_expr(str);
+	normalize_vars(expr);
+	struct Expr *last = expr;
+	while (last->tag == isDisj)
+		last = last->expr2;
+	const char *name = symbol_name(last->var);
+	printf("last variable of %s renamed: %s %s\n", str, name,
+			strcmp(name, "#27") == 0 ? "(OK)" : "(NOT OK)");
+	free_expr(expr);
+}
+
+void test_normalize_vars() {
+	test_normalize_vars_str("q|-q");
+	test_normalize_vars_str("z&(y|z)&-x");
+	test_normalize_vars_str("(a|T)&-b|c");
+	test_normalize_vars_str("x12&(reset_n|x12)|-a");
+	char str[256] = "v26";
+	for (int i = 0; i < 27; i++)
+		snprintf(str + strlen(str), sizeof(str) - strlen(str), "|y%d", i);
+	test_normalize_vars_str(str);
+	test_normalize_late_vars(str);
+}
+
+/* Whether the cached fields of each node of expression are those of the
+ * expression below it, counted again.
+ */
+static bool fields_right(struct Expr *expr, int *size, int *height, unsigned *vars) {
+	int size2 = 0, height2 = 0;
+	unsigned vars2 = 0;
+	bool right = true;
+	*size = 1;
+	*height = 1;
+	*vars = expr->tag == isVar ? VAR_BIT(expr->var) : 0;
+	if (expr->tag == isDisj || expr->tag == isConj || expr->tag == isNeg) {
+		right = fields_right(expr->expr1, size, height, vars);
+		(*size)++;
+		(*height)++;
+	}
+	if (expr->tag == isDisj || expr->tag == isConj) {
+		right = fields_right(expr->expr2, &size2, &height2, &vars2) && right;
+		*size += size2;
+		*height = height2 + 1 > *height ? height2 + 1 : *height;
+		*vars |= vars2;
+	}
+	struct Expr *copy = copy_expr(expr);
+	right = right && expr->size == *size && expr->height == *height &&
+			expr->vars == *vars && expr->hash == copy->hash;
+	free_expr(copy);
+	return right;
+}
+
+/* Test the cached fields of expressions, as read and after renaming.
+ */
+static void test_expr_fields_str(char *str, int size, int height) {
+	struct Expr *expr = read_expr(str);
+	int n, h;
+	unsigned vars;
+	bool right = fields_right(expr, &n, &h, &vars) && n == size && h == height;
+	normalize_vars(expr);
+	right = fields_right(expr, &n, &h, &vars) && right;
+	printf("fields of %s %s\n", str, right ? "(OK)" : "(NOT OK)");
+	free_expr(expr);
+}
+
+void test_expr_fields() {
+	test_expr_fields_str("T", 1, 1);
+	test_expr_fields_str("-(b|c&d)", 6, 4);
+	test_expr_fields_str("z&(y|z)&-x", 8, 4);
+	test_expr_fields_str("x12&(reset_n|x12)|-a", 8, 4);
+	struct Expr *e1 = read_expr("a&b|c");
+	struct Expr *e2 = read_expr("a&c|b");
+	if (e1->vars == e2->vars && e1->size == e2->size && !equal_expr(e1, e2))
+		printf("told apart expressions with the same size and variables (OK)\n");
+	else
+		printf("told apart expressions with the same size and variables (NOT OK)\n");
+	free_expr(e1);
+	free_expr(e2);
+}
@@ -5,4 +5,8 @@ void test_expr_io();
 
 void test_expr_copy();
 
+void test_normalize_vars();
+
+void test_expr_fields();
+
 #endif // TEST_LOGIC_H
@@ -0,0 +1,418 @@
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "laws.h"
+#include "logic.h"
+#include "simplify.h"
+#include "table.h"
+#include "tt.h"
+
+/* Differential test of the search engines against apply, which is the
+ * reference. Random expressions (and the expressions in the corpus
+ * files given as arguments, one per line) are searched with each engine,
+ * for each law set and each depth up to a max, and each result must be
+ * the same as that of apply. A mismatch is shrunk to a smallest
+ * expression that still gives it, and reported with both results.
+ * Usage: test_oracle [-s seed] [-n expressions] [-z max size] [-d max depth]
+ *                    [corpus file ...]
+ * The exit status is 1 if there was a mismatch.
+ */
+
+/* Variations of the search, by the options of run_options and Search
+ * that could change results if they had bugs.
+ */
+struct Engine {
+	char *name;
+	bool no_greedy;
+	bool fixed_order;
+	bool no_scan;
+	bool no_reduction;
+	bool no_prefilter;
+	bool in_place;
+	bool tt;         // with a transposition table kept for the whole test
+	bool normalized; // with variables renamed, as for the memo of a run
+	bool nested;     // as main_all, with all law sets at once
+	bool bfs;        // breadth first on disk, in /tmp, with runs of little memory
+	bool filter;     // with bfs, in memory instead, with a Bloom filter of 1 MB
+	bool table;      // looked up in an answer table if small enough, as with -L
+};
+
+static struct Engine engines[] = {
+	{"search", false, false, false, false, false, false, false, false, false, false, false, false},
+	{"plain search (-G -F -R -B, no scan)", true, true, true, true, true, false, false, false, false, false, false, false},
+	{"search -I", false, false, false, false, false, true, false, false, false, false, false, false},
+	{"search -G -F -B, no scan", true, true, true, false, true, false, false, false, false, false, false, false},
+	{"search with tt", false, false, false, false, false, false, true, false, false, false, false, false},
+	{"search -G -I with tt", true, false, false, false, false, true, true, false, false, false, false, false},
+	{"normalized search", false, false, false, false, false, false, false, true, false, false, false, false},
+	{"nested search", false, false, false, false, false, false, false, false, true, false, false, false},
+	{"nested search -I with tt", false, false, false, false, false, true, true, false, true, false, false, false},
+	{"bfs on disk (-E /tmp -m 4096 -B)", false, false, false, false, true, false, false, false, false, true, false, false},
+	{"nested bfs on disk (-E /tmp -m 4096)", false, false, false, false, false, false, false, false, true, true, false, false},
+	{"bfs with a filter (-A 1M -B)", false, false, false, false, true, false, false, false, false, true, true, false},
+	{"table lookup (-L, up to 6 nodes)", false, false, false, false, false, false, false, false, false, false, false, true}
+};
+
+#define N_ENGINES (int) (sizeof(engines) / sizeof(struct Engine))
+
+static struct TransTable *search_tt;
+static struct TransTable *nested_tt;
+
+static int max_depth = 4;
+
+/* Nodes of the expressions in the answer tables.
+ */
+#define TABLE_NODES 6
+
+/* Answer tables by depth, with all law sets at that depth.
+ */
+static struct AnswerTable **tables;
+
+/* Result of engine for expr with law set k and depth.
+ */
+static int run_engine(struct Engine *engine, struct Expr *expr, int k, int depth) {
+	memset(&run_options, 0, sizeof(run_options));
+	run_options.no_greedy = engine->no_greedy;
+	run_options.fixed_order = engine->fixed_order;
+	run_options.no_reduction = engine->no_reduction;
+	run_options.no_prefilter = engine->no_prefilter;
+	run_options.in_place = engine->in_place;
+	if (engine->bfs && engine->filter) {
+		run_options.bfs_filter = 1 << 20;
+	} else if (engine->bfs) {
+		run_options.bfs_dir = "/tmp";
+		run_options.budget.max_bytes = 4096;
+	}
+	struct LawSet sets[n_law_sets()];
+	for (int i = 0; i < n_law_sets(); i++) {
+		sets[i] = law_sets[i];
+		sets[i].max_depth = depth;
+	}
+	int res;
+	if (engine->table) {
+		struct Expr *copy = copy_expr(expr);
+		normalize_vars(copy);
+		bool found = table_lookup(tables[depth], table_column(tables[depth], sets[k].searches,
+				depth), copy, &res);
+		free_expr(copy);
+		if (found)
+			return res;
+	}
+	if (engine->nested) {
+		struct LawSet *set_ptrs[n_law_sets()];
+		for (int i = 0; i < n_law_sets(); i++)
+			set_ptrs[i] = &sets[i];
+		struct NestedSearch nested;
+		init_nested_search(&nested, set_ptrs, n_law_sets());
+		nested.search.scan = nested.search.scan && !engine->no_scan;
+		if (engine->tt)
+			nested.search.tt = nested_tt;
+		search_nested_derivations(&nested, expr, (1u << n_law_sets()) - 1);
+		res = nested.bests[k];
+	} else {
+		struct Search search;
+		init_search(&search, depth, sets[k].searches, sets[k].applies, sets[k].n_laws);
+		search.scan = search.scan && !engine->no_scan;
+		if (engine->tt) {
+			search.tt = search_tt;
+			search.tt_salt = (k + 1) * 0x9e3779b97f4a7c15ULL;
+		}
+		struct Expr *copy = copy_expr(expr);
+		if (engine->normalized)
+			normalize_vars(copy);
+		res = search_derivation(&search, copy);
+		free_expr(copy);
+	}
+	return res;
+}
+
+/* Result of apply for expr with law set k and each depth up to
+ * max_depth. As apply finds the shortest derivation of fewer steps than
+ * the depth, it is only run once, with max_depth.
+ */
+static void run_apply(struct Expr *expr, int k, int res[]) {
+	struct LawSet *set = &law_sets[k];
+	int max_res = apply(expr, max_depth, max_depth, set->searches, set->applies, set->n_laws);
+	for (int depth = 1; depth <= max_depth; depth++)
+		res[depth] = max_res != -1 && max_res < depth ? max_res : -1;
+}
+
+/* Does engine give another result than apply for expr with law set k
+ * and depth?
+ */
+static bool mismatches(struct Engine *engine, struct Expr *expr, int k, int depth) {
+	int expected[max_depth + 1];
+	run_apply(expr, k, expected);
+	return run_engine(engine, expr, k, depth) != expected[depth];
+}
+
+/* Copy of expr in which the node with number index in prefix order is
+ * replaced by a copy of replacement. *index counts down the nodes.
+ */
+static struct Expr *replace_node(struct Expr *expr, int *index, struct Expr *replacement) {
+	if ((*index)-- == 0)
+		return copy_expr(replacement);
+	switch (expr->tag) {
+		case isDisj: {
+			struct Expr *expr1 = replace_node(expr->expr1, index, replacement);
+			return make_disj(expr1, replace_node(expr->expr2, index, replacement));
+		}
+		case isConj: {
+			struct Expr *expr1 = replace_node(expr->expr1, index, replacement);
+			return make_conj(expr1, replace_node(expr->expr2, index, replacement));
+		}
+		case isNeg:
+			return make_neg(replace_node(expr->expr1, index, replacement));
+		default:
+			return copy_expr(expr);
+	}
+}
+
+/* Node with number index in prefix order. *index counts down the nodes.
+ */
+static struct Expr *node_at(struct Expr *expr, int *index) {
+	if ((*index)-- == 0)
+		return expr;
+	struct Expr *found = NULL;
+	if (expr->tag == isDisj || expr->tag == isConj || expr->tag == isNeg)
+		found = node_at(expr->expr1, index);
+	if (found == NULL && (expr->tag == isDisj || expr->tag == isConj))
+		found = node_at(expr->expr2, index);
+	return found;
+}
+
+/* Smallest expression found from expr that still mismatches, by
+ * replacing nodes by their children or by T, F or a, as long as that
+ * makes the expression smaller. Takes expr.
+ */
+static struct Expr *shrink(struct Engine *engine, struct Expr *expr, int k, int depth) {
+	struct Expr *leaves[] = {make_true(), make_false(), make_var(0)};
+	bool smaller = true;
+	while (smaller) {
+		smaller = false;
+		int size = size_expr(expr);
+		for (int node = 0; node < size && !smaller; node++) {
+			int index = node;
+			struct Expr *sub = node_at(expr, &index);
+			struct Expr *candidates[5];
+			int n = 0;
+			if (sub->tag == isDisj || sub->tag == isConj || sub->tag == isNeg)
+				candidates[n++] = sub->expr1;
+			if (sub->tag == isDisj || sub->tag == isConj)
+				candidates[n++] = sub->expr2;
+			for (int i = 0; i < 3 && size_expr(sub) > 1; i++)
+				candidates[n++] = leaves[i];
+			for (int i = 0; i < n && !smaller; i++) {
+				index = node;
+				struct Expr *shrunk = replace_node(expr, &index, candidates[i]);
+				if (size_expr(shrunk) < size && mismatches(engine, shrunk, k, depth)) {
+					free_expr(expr);
+					expr = shrunk;
+					smaller = true;
+				} else {
+					free_expr(shrunk);
+				}
+			}
+		}
+	}
+	for (int i = 0; i < 3; i++)
+		free_expr(leaves[i]);
+	return expr;
+}
+
+/* Answer table of all law sets at depth, made as make_table does, in
+ * a file that is removed once it is mapped. Return NULL if it cannot be.
+ */
+static struct AnswerTable *make_table(int depth) {
+	struct LawSet sets[n_law_sets()];
+	struct LawSet *set_ptrs[n_law_sets()];
+	for (int i = 0; i < n_law_sets(); i++) {
+		sets[i] = law_sets[i];
+		sets[i].max_depth = depth;
+		set_ptrs[i] = &sets[i];
+	}
+	long n_entries = table_size(TABLE_NODES);
+	unsigned char *results = malloc(n_entries * n_law_sets());
+	struct NestedSearch nested;
+	init_nested_search(&nested, set_ptrs, n_law_sets());
+	for (long rank = 0; rank < n_entries; rank++) {
+		struct Expr *expr = table_unrank(rank, TABLE_NODES);
+		search_nested_derivations(&nested, expr, (1u << n_law_sets()) - 1);
+		for (int k = 0; k < n_law_sets(); k++)
+			results[rank * n_law_sets() + k] = nested.bests[k] == -1 ? 0xff : nested.bests[k];
+		free_expr(expr);
+	}
+	char file_name[] = "/tmp/test_oracleXXXXXX";
+	int fd = mkstemp(file_name);
+	struct AnswerTable *table = NULL;
+	if (fd != -1) {
+		close(fd);
+		if (table_write(file_name, TABLE_NODES, set_ptrs, n_law_sets(), results))
+			table = table_open(file_name);
+		unlink(file_name);
+	}
+	free(results);
+	return table;
+}
+
+static long n_checks;
+static int n_mismatches;
+
+/* Check all engines on expr, and report mismatches.
+ */
+static void check_expr(struct Expr *expr) {
+	for (int k = 0; k < n_law_sets(); k++) {
+		int expected[max_depth + 1];
+		run_apply(expr, k, expected);
+		for (int e = 0; e < N_ENGINES; e++)
+			for (int depth = 1; depth <= max_depth; depth++) {
+				n_checks++;
+				int res = run_engine(&engines[e], expr, k, depth);
+				if (res == expected[depth])
+					continue;
+				n_mismatches++;
+				printf("MISMATCH %s, law set %s, depth %d: ", engines[e].name,
+						law_sets[k].name, depth);
+				print_expr(expr);
+				printf("\n  apply %d, engine %d\n", expected[depth], res);
+				struct Expr *shrunk = shrink(&engines[e], copy_expr(expr), k, depth);
+				int shrunk_expected[max_depth + 1];
+				run_apply(shrunk, k, shrunk_expected);
+				printf("  shrunk to ");
+				print_expr(shrunk);
+				printf(": apply %d, engine %d\n", shrunk_expected[depth],
+						run_engine(&engines[e], shrunk, k, depth));
+				free_expr(shrunk);
+			}
+	}
+}
+
+/* Random expression of at most size nodes, with variables a, b, c.
+ */
+static struct Expr *random_expr(int size) {
+	int choice = size <= 1 ? rand() % 5 : rand() % 10;
+	if (choice < 3)
+		return make_var(choice);
+	if (choice == 3)
+		return make_true();
+	if (choice == 4)
+		return make_false();
+	if (choice == 5 || size == 2)
+		return make_neg(random_expr(size - 1));
+	int size1 = 1 + rand() % (size - 2);
+	struct Expr *expr1 = random_expr(size1);
+	struct Expr *expr2 = random_expr(size - 1 - size1);
+	return choice < 8 ? make_disj(expr1, expr2) : make_conj(expr1, expr2);
+}
+
+/* Random tautology, made of an expression x of at most size nodes and
+ * another y in a shell around x | -x, so that the engines have to find
+ * the steps to T rather than the BDD prefilter ruling them out.
+ */
+static struct Expr *random_tautology(int size) {
+	struct Expr *expr = random_expr(size);
+	struct Expr *neg = make_neg(copy_expr(expr));
+	switch (rand() % 4) {
+		case 0:
+			return make_disj(expr, neg);
+		case 1:
+			return make_disj(make_disj(expr, random_expr(size)), neg);
+		case 2:
+			return make_disj(neg, make_disj(random_expr(size), expr));
+		default: {
+			struct Expr *other = random_expr(size);
+			return make_conj(make_disj(expr, neg),
+					make_disj(make_neg(copy_expr(other)), other));
+		}
+	}
+}
+
+/* Check the expressions in the lines of corpus file.
+ */
+static bool check_corpus(char *file_name) {
+	FILE *file = fopen(file_name, "r");
+	if (file == NULL) {
+		perror(file_name);
+		return false;
+	}
+	char *line = NULL;
+	size_t len = 0;
+	int n_exprs = 0;
+	while (getline(&line, &len, file) != -1) {
+		int size = strlen(line);
+		if (size >= 1 && line[size - 1] == '\n')
+			line[size - 1] = '\0';
+		if (line[0] == '\0' || line[0] == '#')
+			continue;
+		struct Expr *expr = read_expr(line);
+		if (expr == NULL)
+			continue;
+		check_expr(expr);
+		free_expr(expr);
+		n_exprs++;
+	}
+	free(line);
+	fclose(file);
+	printf("%s: %d expressions\n", file_name, n_exprs);
+	return true;
+}
+
+int main(int argc, char **argv) {
+	unsigned seed = 1;
+	int n_exprs = 100;
+	int max_size = 7;
+	int opt;
+	while ((opt = getopt(argc, argv, "s:n:z:d:")) != -1) {
+		switch (opt) {
+			case 's':
+				seed = atoi(optarg);
+				break;
+			case 'n':
+				n_exprs = atoi(optarg);
+				break;
+			case 'z':
+				max_size = atoi(optarg);
+				break;
+			case 'd':
+				max_depth = atoi(optarg);
+				break;
+			default:
+				optind = argc + 1;
+				break;
+		}
+	}
+	if (optind > argc || max_size < 1 || max_depth < 1) {
+		fprintf(stderr, "Usage: %s [-s seed] [-n expressions] [-z max size] [-d max depth] "
+				"[corpus file ...]\n", argv[0]);
+		return 2;
+	}
+	search_tt = tt_new(1 << 16);
+	nested_tt = tt_new(1 << 16);
+	tables = calloc(max_depth + 1, sizeof(struct AnswerTable *));
+	for (int depth = 1; depth <= max_depth; depth++)
+		if ((tables[depth] = make_table(depth)) == NULL) {
+			fprintf(stderr, "Cannot make an answer table\n");
+			return 2;
+		}
+	for (int i = optind; i < argc; i++)
+		if (!check_corpus(argv[i]))
+			return 2;
+	srand(seed);
+	for (int i = 0; i < n_exprs; i++) {
+		int size = 1 + rand() % max_size;
+		struct Expr *expr = i % 2 == 0 ? random_expr(size) : random_tautology((size + 1) / 2);
+		check_expr(expr);
+		free_expr(expr);
+	}
+	printf("seed %u: %d random expressions, %ld checks, %d mismatches\n",
+			seed, n_exprs, n_checks, n_mismatches);
+	tt_free(search_tt);
+	tt_free(nested_tt);
+	for (int depth = 1; depth <= max_depth; depth++)
+		table_close(tables[depth]);
+	free(tables);
+	return n_mismatches > 0;
+}
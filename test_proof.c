@@ -0,0 +1,99 @@
+#include <stdbool.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "laws.h"
+#include "logic.h"
+#include "proof.h"
+#include "test_proof.h"
+
+/* Does result give line 'expected', as verify prints it?
+ */
+static bool result_is(struct ProofResult *result, char *expected) {
+	char line[256];
+	switch (result->kind) {
+		case PROOF_OK:
+			snprintf(line, sizeof(line), "ok %d", result->n_steps);
+			break;
+		case PROOF_BAD_STEP:
+			snprintf(line, sizeof(line), "bad step %d: %s", result->n_steps, result->reason);
+			break;
+		case PROOF_BAD_END:
+			if (strncmp(expected, "bad end: ", 9) != 0)
+				return false;
+			struct Expr *end = read_expr(expected + 9);
+			bool same = end != NULL && equal_expr(end, result->end);
+			if (end != NULL)
+				free_expr(end);
+			return same;
+		case PROOF_ERROR:
+			snprintf(line, sizeof(line), "error");
+			break;
+	}
+	return strcmp(line, expected) == 0;
+}
+
+/* Test checking the proofs in text with law set, which should give the
+ * n_expected lines of verify in 'expected'.
+ */
+static void test_proofs_of(struct LawSet *set, char *text, char *expected[], int n_expected) {
+	FILE *in = fmemopen(text, strlen(text), "r");
+	struct ProofReader reader = {set, in, NULL, 0, {0}};
+	struct ProofResult result;
+	int n = 0;
+	bool same = true;
+	while (next_proof(&reader, &result)) {
+		if (n >= n_expected || !result_is(&result, expected[n]))
+			same = false;
+		if (result.end != NULL)
+			free_expr(result.end);
+		n++;
+	}
+	free_proof_reader(&reader);
+	fclose(in);
+	printf("%d proofs, %s", n, n_expected > 0 ? expected[0] : "none");
+	for (int i = 1; i < n_expected; i++)
+		printf("; %s", expected[i]);
+	printf(same && n == n_expected ? "\n" : " (NOT OK)\n");
+}
+
+void test_proofs() {
+	struct LawSet *set = find_law_set("basic");
+	test_proofs_of(set, "a|-a\ncomplementation disj (forward) at 0\n",
+			(char *[]) {"ok 1"}, 1);
+	test_proofs_of(set, "-a|a\ncommutative disj (forward) at 0\ncomplementation disj (forward) at 0\n"
+			"\n\n(b|-b)&T\ncomplementation disj (forward) at 1 0\n", (char *[]) {"ok 2", "bad end: T&T"}, 2);
+	test_proofs_of(set, "-a|a\ncommutative disj (forward) at 0", (char *[]) {"bad end: a|-a"}, 1);
+	test_proofs_of(set, "T\n\na\n", (char *[]) {"ok 0", "bad end: a"}, 2);
+	test_proofs_of(set, "a|-a\ncomplementation disj (forward) at 1\n",
+			(char *[]) {"bad step 1: bad path"}, 1);
+	test_proofs_of(set, "a|-a\ncomplementation disj (forward) at 3 0\n",
+			(char *[]) {"bad step 1: bad path"}, 1);
+	test_proofs_of(set, "a|-a\ncomplementation disj (forward) at 0 1\n",
+			(char *[]) {"bad step 1: bad path"}, 1);
+	test_proofs_of(set, "a|-a\ncommutative disj (forward) at 1 1 0\n",
+			(char *[]) {"bad step 1: no subexpression at path"}, 1);
+	test_proofs_of(set, "a|b\ncommutative disj (forward) at 0\ncomplementation disj (forward) at 0\n"
+			"commutative disj (forward) at 0\n", (char *[]) {"bad step 2: law does not apply at path"}, 1);
+	test_proofs_of(set, "a|-a\nno such law at 0\n", (char *[]) {"bad step 1: unknown law"}, 1);
+	test_proofs_of(set, "a|-a\ncomplementation disj (forward)\n",
+			(char *[]) {"bad step 1: no \" at \""}, 1);
+	test_proofs_of(set, "a|\nanything at 0\n\na|-a\ncomplementation disj (forward) at 0\n",
+			(char *[]) {"error", "ok 1"}, 2);
+	test_proofs_of(set, "\n\n", (char *[]) {NULL}, 0);
+}
+
+/* Test that the path of a step is after the last " at ", with a law
+ * set of which a law has " at " in its name.
+ */
+void test_proof_law_names() {
+	struct LawSet set = *find_law_set("basic");
+	char *names[set.n_laws];
+	for (int law = 0; law < set.n_laws; law++)
+		names[law] = strcmp(set.names[law], "commutative disj (forward)") == 0 ?
+			"commutative at disj" : set.names[law];
+	set.names = names;
+	test_proofs_of(&set, "-a|a\ncommutative at disj at 0\ncomplementation disj (forward) at 0\n",
+			(char *[]) {"ok 2"}, 1);
+	test_proofs_of(&set, "-a|a\ncommutative at 0\n", (char *[]) {"bad step 1: unknown law"}, 1);
+}
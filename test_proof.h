@@ -0,0 +1,8 @@
+#ifndef TEST_PROOF_H
+#define TEST_PROOF_H
+
+void test_proofs();
+
+void test_proof_law_names();
+
+#endif // TEST_PROOF_H
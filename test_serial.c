@@ -0,0 +1,111 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "logic.h"
+#include "laws.h"
+#include "serial.h"
+#include "test_serial.h"
+
+/* Test encoding and decoding of expression in string 'str'.
+ */
+static void test_serial_expr_str(char *str) {
+	struct Expr *expr = read_expr(str);
+	size_t len;
+	unsigned char *buf = serial_encode_expr(expr, &len);
+	struct Expr *decoded = serial_decode_expr(buf, len);
+	printf("%s in %zu bytes should be same as:\n", str, len);
+	print_expr(decoded);
+	printf("\n");
+	if (!equal_expr(expr, decoded))
+		printf("found different expressions (NOT OK)\n");
+	free(buf);
+	free_expr(expr);
+	free_expr(decoded);
+}
+
+void test_serial_expr() {
+	test_serial_expr_str("T");
+	test_serial_expr_str("z");
+	test_serial_expr_str("a|-a");
+	test_serial_expr_str("(a|b)&-(c|d)|F");
+	test_serial_expr_str("-(a&b)&-(((c|d))&(f&j&l))&a");
+}
+
+/* Write expressions and a result to a stream, in the DAG section or not,
+ * and read them back.
+ */
+static void test_serial_stream_with(int flags) {
+	char *strs[] = {"(a|b)&(a|b)", "a|b|-(a|b)", "(a|b)&(a|b)", "sig_clk&-(sig_clk|x1)"};
+	int path[] = {1, 2, 0};
+	struct ProofStep step = {12, path};
+	struct Result result = {1, resultExact, 1, &step};
+	char *buf = NULL;
+	size_t size = 0;
+	FILE *out = open_memstream(&buf, &size);
+	struct SerialWriter *writer = serial_writer_open(out, flags);
+	for (size_t i = 0; i < sizeof(strs) / sizeof(char *); i++) {
+		struct Expr *expr = read_expr(strs[i]);
+		serial_write_expr(writer, expr);
+		free_expr(expr);
+	}
+	serial_write_result(writer, &result);
+	serial_writer_close(writer);
+	fclose(out);
+	printf("stream with flags %d in %zu bytes:\n", flags, size);
+
+	struct SerialReader *reader = serial_reader_open_mem((unsigned char *) buf, size);
+	struct Expr *expr;
+	struct Result read;
+	enum SerialKind kind;
+	while ((kind = serial_read(reader, &expr, &read)) == serialExpr ||
+			kind == serialResult) {
+		if (kind == serialExpr) {
+			printf("    ");
+			print_expr(expr);
+			printf("\n");
+			free_expr(expr);
+		} else {
+			printf("    result %d, law %d at ", read.steps, read.proof[0].law);
+			print_path(read.proof[0].path);
+			free_result(&read);
+		}
+	}
+	if (kind == serialError)
+		printf("    error (NOT OK)\n");
+	serial_reader_close(reader);
+	free(buf);
+}
+
+void test_serial_stream() {
+	test_serial_stream_with(0);
+	test_serial_stream_with(SERIAL_DAG);
+}
+
+/* Test that n bytes of tags, which are not an expression that is read,
+ * are rejected.
+ */
+static void test_serial_bad_of(char *what, unsigned char *buf, size_t n) {
+	struct Expr *expr = serial_decode_expr(buf, n);
+	printf("%s: %s\n", what, expr == NULL ? "rejected" : "read (NOT OK)");
+	if (expr != NULL)
+		free_expr(expr);
+}
+
+void test_serial_bad() {
+	size_t n = SERIAL_MAX_HEIGHT + 2;
+	unsigned char *buf = malloc(n);
+	memset(buf, isNeg, n - 2);
+	buf[n - 2] = isVar;
+	buf[n - 1] = 0;
+	test_serial_bad_of("negations without end", buf, n - 2);
+	test_serial_bad_of("too high", buf, n);
+	struct Expr *expr = serial_decode_expr(buf + 1, n - 1);
+	printf("as high as can be: %s\n", expr != NULL ? "read" : "rejected (NOT OK)");
+	if (expr != NULL)
+		free_expr(expr);
+	unsigned char unnamed[] = {isDisj, isVar, 0, isVar, 0xff, 0xff, 0xff, 0xff, 0x07};
+	test_serial_bad_of("variable never interned", unnamed, sizeof(unnamed));
+	test_serial_bad_of("disjunction without its second", unnamed, 3);
+	free(buf);
+}
@@ -0,0 +1,10 @@
+#ifndef TEST_SERIAL_H
+#define TEST_SERIAL_H
+
+void test_serial_expr();
+
+void test_serial_stream();
+
+void test_serial_bad();
+
+#endif // TEST_SERIAL_H
@@ -0,0 +1,73 @@
+#include <stdbool.h>
+#include <stdio.h>
+
+#include "logic.h"
+#include "table.h"
+#include "test_table.h"
+
+void test_table_size() {
+	long expected[] = {0, 3, 6, 29, 92, 511, 2194};
+	for (int n = 0; n <= 6; n++) {
+		long size = table_size(n);
+		printf("table size %d: %ld", n, size);
+		printf(size == expected[n] ? "\n" : " (NOT OK)\n");
+	}
+	printf("table size %d: %ld", MAX_TABLE_NODES + 1, table_size(MAX_TABLE_NODES + 1));
+	printf(table_size(MAX_TABLE_NODES + 1) == 0 ? "\n" : " (NOT OK)\n");
+}
+
+/* Test that each rank up to max_nodes nodes is that of its expression,
+ * which has its variables in order of first occurrence, and that there
+ * are no more.
+ */
+static void test_table_rank_nodes(int max_nodes) {
+	long size = table_size(max_nodes);
+	long n_wrong = 0;
+	for (long rank = 0; rank < size; rank++) {
+		struct Expr *expr = table_unrank(rank, max_nodes);
+		struct Expr *normalized = copy_expr(expr);
+		normalize_vars(normalized);
+		if (table_rank(expr, max_nodes) != rank || !equal_expr(expr, normalized) ||
+				size_expr(expr) > max_nodes) {
+			if (n_wrong++ == 0) {
+				printf("  rank %ld: ", rank);
+				print_expr(expr);
+				printf(" has rank %ld\n", table_rank(expr, max_nodes));
+			}
+		}
+		free_expr(normalized);
+		free_expr(expr);
+	}
+	struct Expr *beyond = table_unrank(size, max_nodes);
+	printf("%ld ranks up to %d nodes: %ld wrong", size, max_nodes, n_wrong);
+	printf(n_wrong == 0 && beyond == NULL ? "\n" : " (NOT OK)\n");
+	if (beyond != NULL)
+		free_expr(beyond);
+}
+
+void test_table_rank() {
+	for (int max_nodes = 1; max_nodes <= 6; max_nodes++)
+		test_table_rank_nodes(max_nodes);
+}
+
+/* Test the rank of expression in string 'str', which should be -1
+ * if 'has_rank' is false.
+ */
+static void test_table_no_rank_str(char *str, int max_nodes, bool has_rank) {
+	struct Expr *expr = read_expr(str);
+	long rank = table_rank(expr, max_nodes);
+	printf("rank of %s up to %d nodes: %ld", str, max_nodes, rank);
+	printf((rank != -1) == has_rank ? "\n" : " (NOT OK)\n");
+	free_expr(expr);
+}
+
+void test_table_no_rank() {
+	test_table_no_rank_str("a&b", 6, true);
+	test_table_no_rank_str("b&a", 6, false);
+	test_table_no_rank_str("a|-(b&a)", 6, true);
+	test_table_no_rank_str("a|-(c&b)", 6, false);
+	test_table_no_rank_str("a|-(b&a)", 5, false);
+	test_table_no_rank_str("a|b|c|d", 6, false);
+	test_table_no_rank_str("a", 0, false);
+	test_table_no_rank_str("a", MAX_TABLE_NODES + 1, false);
+}
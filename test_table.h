@@ -0,0 +1,10 @@
+#ifndef TEST_TABLE_H
+#define TEST_TABLE_H
+
+void test_table_size();
+
+void test_table_rank();
+
+void test_table_no_rank();
+
+#endif // TEST_TABLE_H
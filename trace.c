@@ -0,0 +1,229 @@
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "trace.h"
+
+bool trace_on = false;
+
+struct TraceEvent {
+	long long ns;
+	const char *name;
+	int arg;
+	bool begin;
+};
+
+/* Ring buffer of one thread. Once full, the oldest events are overwritten.
+ */
+struct TraceBuffer {
+	struct TraceEvent *events;
+	size_t capacity;
+	size_t count; // number of events ever recorded
+	int tid;
+	struct TraceBuffer *next;
+};
+
+static size_t trace_capacity;
+static pthread_mutex_t buffers_lock = PTHREAD_MUTEX_INITIALIZER;
+static struct TraceBuffer *buffers = NULL;
+static int n_buffers = 0;
+static __thread struct TraceBuffer *buffer = NULL;
+
+/* Start tracing, keeping at most 'capacity' events per thread.
+ */
+void trace_enable(size_t capacity) {
+	trace_capacity = capacity;
+	trace_on = true;
+}
+
+static long long now_ns() {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+static struct TraceBuffer *thread_buffer() {
+	if (buffer == NULL) {
+		buffer = calloc(1, sizeof(struct TraceBuffer));
+		buffer->capacity = trace_capacity;
+		buffer->events = malloc(trace_capacity * sizeof(struct TraceEvent));
+		pthread_mutex_lock(&buffers_lock);
+		buffer->tid = ++n_buffers;
+		buffer->next = buffers;
+		buffers = buffer;
+		pthread_mutex_unlock(&buffers_lock);
+	}
+	return buffer;
+}
+
+static void record(const char *name, int arg, bool begin) {
+	struct TraceBuffer *buf = thread_buffer();
+	struct TraceEvent *event = &buf->events[buf->count++ % buf->capacity];
+	event->ns = now_ns();
+	event->name = name;
+	event->arg = arg;
+	event->begin = begin;
+}
+
+void trace_begin(const char *name, int arg) {
+	record(name, arg, true);
+}
+
+void trace_end(const char *name) {
+	record(name, -1, false);
+}
+
+/*******************************************/
+/* Export.                                 */
+/*******************************************/
+
+/* A begin event matched with its end event, or with the last event of
+ * the thread if it has not ended.
+ */
+struct Span {
+	struct TraceEvent *begin;
+	long long end_ns;
+	int depth;
+};
+
+/* Match events of buffer, oldest first. Ends of which the begin has been
+ * overwritten are dropped. Return number of spans, in order of beginning.
+ */
+static size_t match_spans(struct TraceBuffer *buf, struct Span **spans) {
+	size_t n = buf->count < buf->capacity ? buf->count : buf->capacity;
+	size_t first = buf->count - n;
+	*spans = malloc((n + 1) * sizeof(struct Span));
+	size_t *stack = malloc((n + 1) * sizeof(size_t));
+	size_t n_spans = 0;
+	int depth = 0;
+	long long last_ns = 0;
+	for (size_t i = first; i < buf->count; i++) {
+		struct TraceEvent *event = &buf->events[i % buf->capacity];
+		last_ns = event->ns;
+		if (event->begin) {
+			(*spans)[n_spans].begin = event;
+			(*spans)[n_spans].end_ns = -1;
+			(*spans)[n_spans].depth = depth;
+			stack[depth++] = n_spans++;
+		} else if (depth > 0) {
+			(*spans)[stack[--depth]].end_ns = event->ns;
+		}
+	}
+	while (depth > 0)
+		(*spans)[stack[--depth]].end_ns = last_ns;
+	free(stack);
+	return n_spans;
+}
+
+static void write_json_string(FILE *out, const char *str) {
+	fputc('"', out);
+	for (; *str != '\0'; str++) {
+		if (*str == '"' || *str == '\\')
+			fputc('\\', out);
+		fputc(*str, out);
+	}
+	fputc('"', out);
+}
+
+/* Write all spans as complete ("X") events, in microseconds.
+ */
+bool trace_export_chrome(char *file_name) {
+	FILE *out = fopen(file_name, "w");
+	if (out == NULL) {
+		perror(file_name);
+		return false;
+	}
+	fprintf(out, "{\"traceEvents\":[\n");
+	bool first = true;
+	pthread_mutex_lock(&buffers_lock);
+	for (struct TraceBuffer *buf = buffers; buf != NULL; buf = buf->next) {
+		struct Span *spans;
+		size_t n = match_spans(buf, &spans);
+		for (size_t i = 0; i < n; i++) {
+			struct TraceEvent *event = spans[i].begin;
+			fprintf(out, "%s{\"name\":", first ? "" : ",\n");
+			write_json_string(out, event->name);
+			fprintf(out, ",\"ph\":\"X\",\"pid\":1,\"tid\":%d,\"ts\":%.3f,\"dur\":%.3f",
+					buf->tid, event->ns / 1000.0, (spans[i].end_ns - event->ns) / 1000.0);
+			if (event->arg >= 0)
+				fprintf(out, ",\"args\":{\"n\":%d}", event->arg);
+			fprintf(out, "}");
+			first = false;
+		}
+		free(spans);
+	}
+	pthread_mutex_unlock(&buffers_lock);
+	fprintf(out, "\n]}\n");
+	return fclose(out) == 0;
+}
+
+struct Stack {
+	char *frames;
+	long long ns;
+};
+
+static int compare_stacks(const void *a, const void *b) {
+	return strcmp(((const struct Stack *) a)->frames, ((const struct Stack *) b)->frames);
+}
+
+/* Write self time in ns per stack of frames, such as
+ * "line=3;depth=0;law=2;apply 1200". Threads are merged.
+ */
+bool trace_export_folded(char *file_name) {
+	FILE *out = fopen(file_name, "w");
+	if (out == NULL) {
+		perror(file_name);
+		return false;
+	}
+	struct Stack *stacks = NULL;
+	size_t n_stacks = 0;
+	pthread_mutex_lock(&buffers_lock);
+	for (struct TraceBuffer *buf = buffers; buf != NULL; buf = buf->next) {
+		struct Span *spans;
+		size_t n = match_spans(buf, &spans);
+		stacks = realloc(stacks, (n_stacks + n) * sizeof(struct Stack));
+		size_t *open = malloc((n + 1) * sizeof(size_t));
+		for (size_t i = 0; i < n; i++) {
+			open[spans[i].depth] = i;
+			char frames[4096] = "";
+			size_t len = 0;
+			for (int d = 0; d <= spans[i].depth && len < sizeof(frames) - 64; d++) {
+				struct TraceEvent *event = spans[open[d]].begin;
+				if (event->arg >= 0)
+					len += snprintf(frames + len, sizeof(frames) - len, "%s%s=%d",
+							d > 0 ? ";" : "", event->name, event->arg);
+				else
+					len += snprintf(frames + len, sizeof(frames) - len, "%s%s",
+							d > 0 ? ";" : "", event->name);
+			}
+			// self time: own time minus that of the children
+			long long ns = spans[i].end_ns - spans[i].begin->ns;
+			for (size_t j = i + 1; j < n && spans[j].depth > spans[i].depth; j++)
+				if (spans[j].depth == spans[i].depth + 1)
+					ns -= spans[j].end_ns - spans[j].begin->ns;
+			stacks[n_stacks].frames = strdup(frames);
+			stacks[n_stacks].ns = ns;
+			n_stacks++;
+		}
+		free(open);
+		free(spans);
+	}
+	pthread_mutex_unlock(&buffers_lock);
+	qsort(stacks, n_stacks, sizeof(struct Stack), compare_stacks);
+	for (size_t i = 0; i < n_stacks; ) {
+		size_t j = i;
+		long long ns = 0;
+		for (; j < n_stacks && strcmp(stacks[j].frames, stacks[i].frames) == 0; j++)
+			ns += stacks[j].ns;
+		if (ns > 0)
+			fprintf(out, "%s %lld\n", stacks[i].frames, ns);
+		for (size_t k = i; k < j; k++)
+			free(stacks[k].frames);
+		i = j;
+	}
+	free(stacks);
+	return fclose(out) == 0;
+}
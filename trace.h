@@ -0,0 +1,26 @@
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+/* Tracing of scoped events, such as the search of one input line or the
+ * application of one law. Events are kept per thread in a ring buffer,
+ * so that only the latest ones are kept, and can be exported as Chrome
+ * trace events (for chrome://tracing or Perfetto) and as folded stacks
+ * (for flamegraph.pl). Names must be string constants; an argument of -1
+ * is not shown.
+ */
+
+extern bool trace_on;
+
+#define TRACE_BEGIN(name, arg) do { if (trace_on) trace_begin(name, arg); } while (0)
+#define TRACE_END(name) do { if (trace_on) trace_end(name); } while (0)
+
+void trace_enable(size_t capacity);
+void trace_begin(const char *name, int arg);
+void trace_end(const char *name);
+bool trace_export_chrome(char *file_name);
+bool trace_export_folded(char *file_name);
+
+#endif // TRACE_H
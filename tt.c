@@ -0,0 +1,148 @@
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdlib.h>
+
+#include "tt.h"
+
+/* Number of slots in which a hash may be found. They are in one cache line.
+ */
+#define WINDOW 4
+
+/* The data of a slot holds the result (0xff for none) in bits 0-7, the
+ * horizon in bits 8-15, and bit 63 to tell it from an empty slot (0).
+ * The check is the hash xor the data, so that a slot of which the two
+ * words were written by different writers does not match any hash.
+ */
+struct TransSlot {
+	_Atomic unsigned long long check;
+	_Atomic unsigned long long data;
+};
+
+struct TransTable {
+	struct TransSlot *slots;
+	size_t mask;
+};
+
+#define USED (1ULL << 63)
+#define NONE 0xff
+
+static unsigned long long pack(int horizon, int result) {
+	if (horizon > 0xff)
+		horizon = 0xff;
+	return USED | (unsigned long long) horizon << 8 | (result < 0 ? NONE : result & 0xff);
+}
+
+static int horizon_of(unsigned long long data) {
+	return (data >> 8) & 0xff;
+}
+
+static int result_of(unsigned long long data) {
+	int result = data & 0xff;
+	return result == NONE ? -1 : result;
+}
+
+/* Number of slots is rounded up to a power of two.
+ */
+struct TransTable *tt_new(size_t slots) {
+	struct TransTable *tt = malloc(sizeof(struct TransTable));
+	size_t cap = WINDOW;
+	while (cap < slots)
+		cap *= 2;
+	tt->slots = aligned_alloc(WINDOW * sizeof(struct TransSlot), cap * sizeof(struct TransSlot));
+	for (size_t i = 0; i < cap; i++) {
+		atomic_init(&tt->slots[i].check, 0);
+		atomic_init(&tt->slots[i].data, 0);
+	}
+	tt->mask = cap - 1;
+	return tt;
+}
+
+static struct TransSlot *window_of(struct TransTable *tt, unsigned long long hash) {
+	return &tt->slots[hash & tt->mask & ~(size_t) (WINDOW - 1)];
+}
+
+/* Look up the result of a search with the given horizon. A result that
+ * was found is the shortest whatever the horizon; that there is none is
+ * only known for horizons up to that of the entry.
+ * Return whether the result is known.
+ */
+bool tt_probe(struct TransTable *tt, unsigned long long hash, int horizon, int *result) {
+	struct TransSlot *window = window_of(tt, hash);
+	for (int i = 0; i < WINDOW; i++) {
+		unsigned long long data = atomic_load_explicit(&window[i].data, memory_order_relaxed);
+		unsigned long long check = atomic_load_explicit(&window[i].check, memory_order_relaxed);
+		if (data == 0 || (check ^ data) != hash)
+			continue;
+		int found = result_of(data);
+		if (found != -1) {
+			*result = found < horizon ? found : -1;
+			return true;
+		}
+		if (horizon_of(data) >= horizon) {
+			*result = -1;
+			return true;
+		}
+		return false;
+	}
+	return false;
+}
+
+/* Value of keeping an entry: found results are worth most,
+ * then results of searches with larger horizons.
+ */
+static int worth(unsigned long long data) {
+	if (data == 0)
+		return -1;
+	return result_of(data) != -1 ? 0x100 : horizon_of(data);
+}
+
+/* Store in the slot of the same hash, else in the slot worth least
+ * (empty or torn slots are worth nothing), unless that is worth more
+ * than the new entry. The data is replaced by compare-and-swap, so that
+ * of two writers of one slot only one succeeds; the other drops its entry.
+ */
+void tt_store(struct TransTable *tt, unsigned long long hash, int horizon, int result) {
+	struct TransSlot *window = window_of(tt, hash);
+	unsigned long long new_data = pack(horizon, result);
+	struct TransSlot *victim = NULL;
+	unsigned long long victim_data = 0;
+	int victim_worth = 0;
+	for (int i = 0; i < WINDOW; i++) {
+		unsigned long long data = atomic_load_explicit(&window[i].data, memory_order_relaxed);
+		unsigned long long check = atomic_load_explicit(&window[i].check, memory_order_relaxed);
+		unsigned long long other = check ^ data;
+		if (data != 0 && other == hash) {
+			victim = &window[i];
+			victim_data = data;
+			victim_worth = worth(data);
+			break;
+		}
+		bool torn = data != 0 && window_of(tt, other) != window;
+		int slot_worth = torn ? -1 : worth(data);
+		if (victim == NULL || slot_worth < victim_worth) {
+			victim = &window[i];
+			victim_data = data;
+			victim_worth = slot_worth;
+		}
+	}
+	if (victim_worth > worth(new_data))
+		return;
+	if (atomic_compare_exchange_strong_explicit(&victim->data, &victim_data, new_data,
+			memory_order_relaxed, memory_order_relaxed))
+		atomic_store_explicit(&victim->check, hash ^ new_data, memory_order_relaxed);
+}
+
+/* Number of slots in use. This counts every slot, so it is slow.
+ */
+long tt_entries(struct TransTable *tt) {
+	long entries = 0;
+	for (size_t i = 0; i <= tt->mask; i++)
+		if (atomic_load_explicit(&tt->slots[i].data, memory_order_relaxed) != 0)
+			entries++;
+	return entries;
+}
+
+void tt_free(struct TransTable *tt) {
+	free(tt->slots);
+	free(tt);
+}
@@ -0,0 +1,25 @@
+#ifndef TT_H
+#define TT_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+/* Transposition table: results of searches from expressions, keyed by
+ * a 64-bit hash of the expression. It has a fixed size and can be shared
+ * by threads without locks. Writers that race may lose entries, and a
+ * torn entry is seen as empty; as in chess engines, this is accepted.
+ * Different expressions with the same hash are not told apart.
+ *
+ * An entry holds the result of a search with a horizon: the number of
+ * steps of the shortest derivation of T of fewer than 'horizon' steps,
+ * or -1 if there is none.
+ */
+struct TransTable;
+
+struct TransTable *tt_new(size_t slots);
+bool tt_probe(struct TransTable *tt, unsigned long long hash, int horizon, int *result);
+void tt_store(struct TransTable *tt, unsigned long long hash, int horizon, int result);
+long tt_entries(struct TransTable *tt);
+void tt_free(struct TransTable *tt);
+
+#endif // TT_H
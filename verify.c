@@ -0,0 +1,66 @@
+#include <stdbool.h>
+#include <stdio.h>
+#include <unistd.h>
+
+#include "laws.h"
+#include "logic.h"
+#include "proof.h"
+
+/* Check derivations, without searching.
+ * Usage: verify [-l law set]
+ * The input is a number of proofs (see proof.h), each of which is an
+ * expression and then a line per step
+ *   <law name> at <path>
+ * with the name of a law of the law set (default "basic", see
+ * find_law_set) and a path as printed by print_path, e.g. "2 1 0",
+ * then an empty line or the end of the input. For each proof, one of
+ * these lines is printed:
+ *   ok <steps>               each step applies its law where the law
+ *                            applies, and the last one gives T
+ *   bad step <i>: <reason>   step i (from 1) is the first that does not
+ *   bad end: <expression>    the steps do not end in T, but here
+ *   error                    the expression cannot be read
+ */
+int main(int argc, char **argv) {
+	struct LawSet *set = find_law_set("basic");
+	int opt;
+	while ((opt = getopt(argc, argv, "l:")) != -1) {
+		if (opt == 'l')
+			set = find_law_set(optarg);
+		else
+			optind = argc + 1;
+	}
+	if (optind != argc || set == NULL) {
+		fprintf(stderr, "Usage: %s [-l law set]\n", argv[0]);
+		return 2;
+	}
+	for (int law = 0; law < set->n_laws; law++)
+		if (law_info(set->searches[law]) == NULL) {
+			fprintf(stderr, "No info on law %s\n", set->names[law]);
+			return 2;
+		}
+
+	struct ProofReader reader = {set, stdin, NULL, 0, {0}};
+	struct ProofResult result;
+	while (next_proof(&reader, &result)) {
+		switch (result.kind) {
+			case PROOF_OK:
+				printf("ok %d\n", result.n_steps);
+				break;
+			case PROOF_BAD_STEP:
+				printf("bad step %d: %s\n", result.n_steps, result.reason);
+				break;
+			case PROOF_BAD_END:
+				printf("bad end: ");
+				print_expr(result.end);
+				printf("\n");
+				free_expr(result.end);
+				break;
+			case PROOF_ERROR:
+				printf("error\n");
+				break;
+		}
+	}
+	free_proof_reader(&reader);
+	return 0;
+}